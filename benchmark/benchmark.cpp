@@ -0,0 +1,382 @@
+// Times the hot paths over scripts of 10 to 10 million actions and writes the results as JSON, so runs from one
+// release can be compared with the next. Nothing is sent anywhere, replays go to a loopback backend...
+//
+//	ghost_benchmark [--min actions] [--max actions] [--budget seconds] [--only name] [--out file.json]
+
+#include "../include/ghost.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+	typedef std::chrono::steady_clock clock;
+
+	struct options
+	{
+		options()
+			: min_(10), max_(10000000), budget_(0.5) {}
+
+		std::size_t min_, max_;
+		double budget_;			// seconds spent timing each benchmark at each size, at least one run is always timed
+		std::string only_;		// run the benchmarks whose names start with this
+		std::string out_;		// stdout if empty
+	};
+
+	struct result
+	{
+		std::string name_;
+		std::size_t actions_;
+		unsigned int threads_;
+		std::uint64_t iterations_;
+		double best_, mean_;	// seconds per run
+	};
+
+	class suite
+	{
+	public:
+		suite(const options& o)
+			: options_(o) {}
+
+		// time f, which runs the benchmark once and returns how long the part being measured took, until the
+		// budget is spent. Setup outside the measured part counts against a looser limit...
+		template<typename F>
+		void run(const std::string& name, std::size_t actions, unsigned int threads, F f)
+		{
+			if (name.compare(0, options_.only_.size(), options_.only_))
+				return;
+
+			std::cerr << name << " " << actions;
+			if (threads)
+				std::cerr << " on " << threads << " threads";
+			std::cerr << "..." << std::endl;
+
+			result r = { name, actions, threads, 0, 0.0, 0.0 };
+			double total = 0.0;
+			clock::time_point start = clock::now();
+			do
+			{
+				double took = std::chrono::duration<double>(f()).count();
+				r.best_ = r.iterations_ ? (std::min)(r.best_, took) : took;
+				total += took;
+				++r.iterations_;
+			} while (total < options_.budget_ && std::chrono::duration<double>(clock::now() - start).count() < options_.budget_ * 4);
+			r.mean_ = total / r.iterations_;
+			results_.push_back(r);
+		}
+
+		void write(std::ostream& os) const
+		{
+			os << std::setprecision(9);
+			os << "{\n";
+			os << "\t\"context\": {\n";
+			os << "\t\t\"compiler\": \"" << compiler() << "\",\n";
+			os << "\t\t\"build\": \"" << build() << "\",\n";
+			os << "\t\t\"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n";
+			os << "\t\t\"budget\": " << options_.budget_ << "\n";
+			os << "\t},\n";
+			os << "\t\"benchmarks\": [";
+			for (std::size_t i = 0; i < results_.size(); ++i)
+			{
+				const result& r = results_[i];
+				double perAction = r.actions_ ? r.best_ / r.actions_ : 0.0;
+				os << (i ? ",\n" : "\n") << "\t\t{ ";
+				os << "\"name\": \"" << r.name_ << "\", ";
+				os << "\"actions\": " << r.actions_ << ", ";
+				if (r.threads_)
+					os << "\"threads\": " << r.threads_ << ", ";
+				os << "\"iterations\": " << r.iterations_ << ", ";
+				os << "\"best_seconds\": " << r.best_ << ", ";
+				os << "\"mean_seconds\": " << r.mean_ << ", ";
+				os << "\"ns_per_action\": " << perAction * 1e9 << ", ";
+				os << "\"actions_per_second\": " << (perAction > 0.0 ? 1.0 / perAction : 0.0) << " }";
+			}
+			os << "\n\t]\n}\n";
+		}
+
+	private:
+		static std::string compiler()
+		{
+			std::ostringstream oss;
+#if defined(__clang__)
+			oss << "clang " << __clang_major__ << "." << __clang_minor__ << "." << __clang_patchlevel__;
+#elif defined(__GNUC__)
+			oss << "gcc " << __GNUC__ << "." << __GNUC_MINOR__ << "." << __GNUC_PATCHLEVEL__;
+#elif defined(_MSC_VER)
+			oss << "msvc " << _MSC_VER;
+#else
+			oss << "unknown";
+#endif
+			return oss.str();
+		}
+
+		static const char* build()
+		{
+#ifdef NDEBUG
+			return "release";
+#else
+			return "debug";
+#endif
+		}
+
+		options options_;
+		std::vector<result> results_;
+	};
+
+	template<typename F>
+	clock::duration timed(F f)
+	{
+		clock::time_point start = clock::now();
+		f();
+		return clock::now() - start;
+	}
+
+	// what action i of a workload is. Mostly moves as in a recording, with clicks, keys and some text. Nothing which
+	// waits, so replays measure ghost rather than sleeping...
+	template<typename F>
+	void workload(std::size_t actions, bool text, F f)
+	{
+		for (std::size_t i = 0; i < actions; ++i)
+		{
+			int x = static_cast<int>(i * 7 % 1920), y = static_cast<int>(i * 13 % 1080);
+			unsigned char k = static_cast<unsigned char>('a' + i / 16 % 26);
+			std::size_t kind = i % 16;
+			if (kind == 15 && !text)
+				kind = 0;
+			switch (kind)
+			{
+			case 8:
+				f(ghost::mouse::down(ghost::mouse::button::Left, x, y));
+				break;
+			case 9:
+				f(ghost::mouse::up(ghost::mouse::button::Left, x, y));
+				break;
+			case 10:
+				f(ghost::keyboard::down(k));
+				break;
+			case 11:
+				f(ghost::keyboard::up(k));
+				break;
+			case 15:
+				f(ghost::keyboard::text("ghost"));
+				break;
+			default:
+				f(ghost::mouse::move(x, y));
+			}
+		}
+	}
+
+	ghost::script generate(std::size_t actions)
+	{
+		ghost::script result;
+		workload(actions, true, [&result](const auto& a) { result.add(a); });
+		return result;
+	}
+
+	void parse(suite& s, std::size_t actions, const std::string& text)
+	{
+		s.run("parse", actions, 0, [&text]()
+		{
+			clock::duration took;
+			{
+				clock::time_point start = clock::now();
+				ghost::script parsed(text);
+				took = clock::now() - start;
+			}
+			return took;
+		});
+
+		// the same text split across threads, the chunks are too small to split below 64k...
+		unsigned int most = (std::max)(1u, std::thread::hardware_concurrency());
+		for (unsigned int threads = 1; ; threads = (std::min)(threads * 2, most))
+		{
+			s.run("parse/parallel", actions, threads, [&text, threads]()
+			{
+				clock::duration took;
+				{
+					clock::time_point start = clock::now();
+					ghost::script parsed(text, threads);
+					took = clock::now() - start;
+				}
+				return took;
+			});
+			if (threads == most)
+				break;
+		}
+	}
+
+	void syntax(suite& s, std::size_t actions, ghost::script& script)
+	{
+		s.run("syntax", actions, 0, [&script]() { return timed([&script]() { script.syntax(); }); });
+	}
+
+	void replay(suite& s, std::size_t actions, ghost::script& script)
+	{
+		// counts what it is sent and keeps none of it...
+		ghost::loopback sink(0);
+
+		s.run("replay/script", actions, 0, [&]() { return timed([&]() { script.play(sink); }); });
+
+		ghost::playback measured;
+		measured.measure_ = true;
+		s.run("replay/measured", actions, 0, [&]() { return timed([&]() { script.play(sink, measured); }); });
+
+		ghost::playback burst;
+		burst.burst_ = 256;
+		s.run("replay/burst", actions, 0, [&]() { return timed([&]() { script.play(sink, burst); }); });
+
+		// measured bursts read the clock once a burst...
+		ghost::playback measuredBurst = burst;
+		measuredBurst.measure_ = true;
+		s.run("replay/burst/measured", actions, 0, [&]() { return timed([&]() { script.play(sink, measuredBurst); }); });
+
+		ghost::plan compiled = script.compile();
+		s.run("replay/plan", actions, 0, [&]() { return timed([&]() { compiled.play(sink); }); });
+	}
+
+	// events pushed as the hooks push them, from when the first is pushed until the last has been turned into an
+	// action. Pushing holds back while the ring is half full, so nothing is dropped...
+	void record(suite& s, std::size_t actions, const std::string& name, const ghost::record::simplify& paths)
+	{
+		std::vector<ghost::binary::record> events;
+		events.reserve(actions);
+		std::string text;
+		workload(actions, false, [&events, &text](const ghost::injectable& a)
+		{
+			ghost::binary::record r = {};
+			a.encode(r, text);
+			events.push_back(r);
+		});
+
+		s.run(name, actions, 0, [&]()
+		{
+			const std::size_t capacity = 1 << 16;
+			ghost::script recorded;
+			ghost::record::pipeline p(capacity, paths);
+			p.listen(&recorded);
+			return timed([&]()
+			{
+				p.start();
+				for (std::size_t i = 0; i < events.size(); ++i)
+				{
+					while (i - p.received() >= capacity / 2)
+						std::this_thread::yield();
+					ghost::record::event e = { events[i], ghost::record::event::now() };
+					p.push(e);
+				}
+				p.stop();
+			});
+		});
+	}
+
+	// actions held by the script itself, and as separately allocated actions...
+	void allocate(suite& s, std::size_t actions)
+	{
+		s.run("allocate/script", actions, 0, [actions]()
+		{
+			clock::duration took;
+			{
+				ghost::script script;
+				took = timed([&]() { workload(actions, true, [&script](const auto& a) { script.add(a); }); });
+			}
+			return took;
+		});
+
+		s.run("teardown/script", actions, 0, [actions]()
+		{
+			std::unique_ptr<ghost::script> script(new ghost::script(generate(actions)));
+			return timed([&]() { script.reset(); });
+		});
+
+		auto shared = [actions](std::vector<ghost::action>& result)
+		{
+			result.reserve(actions);
+			workload(actions, true, [&result](const auto& a) { result.push_back(std::make_shared<typename std::decay<decltype(a)>::type>(a)); });
+		};
+
+		s.run("allocate/shared", actions, 0, [&]()
+		{
+			std::vector<ghost::action> held;
+			return timed([&]() { shared(held); });
+		});
+
+		s.run("teardown/shared", actions, 0, [&]()
+		{
+			std::vector<ghost::action> held;
+			shared(held);
+			return timed([&]() { std::vector<ghost::action>().swap(held); });
+		});
+	}
+
+	bool arguments(int argc, char** argv, options& o)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			if (i + 1 == argc)
+				return false;
+			std::string name = argv[i], value = argv[++i];
+			if (name == "--min")
+				o.min_ = static_cast<std::size_t>(std::strtoull(value.c_str(), nullptr, 10));
+			else if (name == "--max")
+				o.max_ = static_cast<std::size_t>(std::strtoull(value.c_str(), nullptr, 10));
+			else if (name == "--budget")
+				o.budget_ = std::strtod(value.c_str(), nullptr);
+			else if (name == "--only")
+				o.only_ = value;
+			else if (name == "--out")
+				o.out_ = value;
+			else
+				return false;
+		}
+		return o.min_ && o.min_ <= o.max_;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	options o;
+	if (!arguments(argc, argv, o))
+	{
+		std::cerr << "usage: ghost_benchmark [--min actions] [--max actions] [--budget seconds] [--only name] [--out file.json]" << std::endl;
+		return 1;
+	}
+
+	suite s(o);
+	for (std::size_t actions = o.min_; actions <= o.max_; actions *= 10)
+	{
+		// each size is built and freed in turn, the largest needs a few hundred megabytes...
+		{
+			ghost::script script = generate(actions);
+			std::string text = script.syntax();
+			parse(s, actions, text);
+			syntax(s, actions, script);
+			replay(s, actions, script);
+		}
+
+		record(s, actions, "record", ghost::record::simplify());
+		ghost::record::simplify paths;
+		paths.enabled_ = true;
+		record(s, actions, "record/simplified", paths);
+
+		allocate(s, actions);
+
+		if (actions > o.max_ / 10)
+			break;
+	}
+
+	if (o.out_.empty())
+		s.write(std::cout);
+	else
+	{
+		std::ofstream file(o.out_);
+		s.write(file);
+		if (!file)
+		{
+			std::cerr << "Unable to write " << o.out_ << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
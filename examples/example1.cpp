@@ -85,6 +85,39 @@ int main(int argc, char** argv)
 
 	}
 
+	{
+		// the same macro fixed at compile time...
+		constexpr auto macro = ghost::fixed::script(
+			ghost::fixed::exec("cmd"),
+			ghost::fixed::wait(1000),
+			ghost::fixed::press('e'),
+			ghost::fixed::wait(100),
+			ghost::fixed::press('x'),
+			ghost::fixed::wait(100),
+			ghost::fixed::press('i'),
+			ghost::fixed::wait(100),
+			ghost::fixed::press('t'),
+			ghost::fixed::wait(1000),
+			ghost::fixed::press(ghost::keyboard::key::Enter));
+
+		ghost::program::exec cmd("cmd");
+		cmd.run();
+		macro.play();
+		cmd.wait();
+	}
+
+	{
+		// waiting for notepad to be ready rather than for a second it may or may not need...
+		ghost::program::exec notepad("notepad");
+		notepad.run();
+
+		ghost::inject(ghost::program::idle(5000));
+		ghost::inject(ghost::program::focus("Untitled - Notepad", 5000));
+		ghost::inject(ghost::keyboard::text("close me"));
+
+		notepad.wait();
+	}
+
 	return 0;
 
 }
\ No newline at end of file
@@ -36,6 +36,18 @@ DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
 #ifdef _WIN32
 #define GHOST_WINDOWS
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
 #endif
 
 
@@ -47,7 +59,26 @@ DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
 #include <vector>
 #include <memory>
 #include <list>
+#include <deque>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <functional>
+
+#ifndef GHOST_LOG_LEVEL
+#define GHOST_LOG_LEVEL 1		// the least severe entries compiled in, see logger::severity
+#endif
 
 namespace ghost
 {
@@ -55,9 +86,165 @@ namespace ghost
 #ifdef GHOST_ENABLE_MESSAGES
 	static std::function<void(const std::string& msg)> messageCallback;
 #endif
-	
 
-	
+#ifndef GHOST_WINDOWS
+	// the subset of the Win32 input types used by the actions, so they can be lowered and sent to a backend elsewhere...
+	namespace win32
+	{
+		typedef std::uint32_t DWORD;
+		typedef std::int32_t LONG;
+		typedef std::uint16_t WORD;
+		typedef std::uintptr_t ULONG_PTR;
+		typedef unsigned int UINT;
+
+		struct MOUSEINPUT
+		{
+			LONG dx;
+			LONG dy;
+			DWORD mouseData;
+			DWORD dwFlags;
+			DWORD time;
+			ULONG_PTR dwExtraInfo;
+		};
+
+		struct KEYBDINPUT
+		{
+			WORD wVk;
+			WORD wScan;
+			DWORD dwFlags;
+			DWORD time;
+			ULONG_PTR dwExtraInfo;
+		};
+
+		struct INPUT
+		{
+			DWORD type;
+			union
+			{
+				MOUSEINPUT mi;
+				KEYBDINPUT ki;
+			};
+		};
+
+		static const DWORD INPUT_MOUSE = 0;
+		static const DWORD INPUT_KEYBOARD = 1;
+
+		static const DWORD MOUSEEVENTF_MOVE = 0x0001;
+		static const DWORD MOUSEEVENTF_LEFTDOWN = 0x0002;
+		static const DWORD MOUSEEVENTF_LEFTUP = 0x0004;
+		static const DWORD MOUSEEVENTF_RIGHTDOWN = 0x0008;
+		static const DWORD MOUSEEVENTF_RIGHTUP = 0x0010;
+		static const DWORD MOUSEEVENTF_MIDDLEDOWN = 0x0020;
+		static const DWORD MOUSEEVENTF_MIDDLEUP = 0x0040;
+		static const DWORD MOUSEEVENTF_XDOWN = 0x0080;
+		static const DWORD MOUSEEVENTF_XUP = 0x0100;
+		static const DWORD MOUSEEVENTF_WHEEL = 0x0800;
+		static const DWORD MOUSEEVENTF_ABSOLUTE = 0x8000;
+
+		static const DWORD KEYEVENTF_KEYUP = 0x0002;
+		static const DWORD KEYEVENTF_UNICODE = 0x0004;
+		static const DWORD KEYEVENTF_SCANCODE = 0x0008;
+
+		static const unsigned char VK_RETURN = 0x0D;
+	}
+	using namespace win32;
+#endif
+
+	// action ids, str holds their op in script syntax...
+	namespace ID
+	{
+		enum id
+		{
+			Exec = 0,
+			Wait,
+			MouseDown,
+			MouseUp,
+			MouseWheel,
+			MouseMove,
+			KeyDown,
+			KeyUp,
+			KeyPress,
+			KeyType,
+			KeyText,
+			Idle,
+			Window,
+			Focus,
+			Until,
+			CairoElephant
+		};
+
+		static const std::vector<std::string> str({
+			"exec",
+			"w",
+			"md",
+			"mu",
+			"mw",
+			"mm",
+			"kd",
+			"ku",
+			"kp",
+			"kt",
+			"kx",
+			"wi",
+			"ww",
+			"wf",
+			"wu",
+			"ce"
+			});
+
+		// ops followed by text...
+		inline bool text(unsigned int id)
+		{
+			return id == Exec || id == KeyType || id == KeyText || id == Window || id == Focus || id == Until;
+		}
+	}
+
+	// scripts stored as fixed width little endian records, which can be mapped and replayed where they lie...
+	namespace binary
+	{
+		static const std::uint16_t version = 1;
+		static const char magic[] = { 'G', 'H', 'S', 'T' };
+
+		// followed by the opcode table, then the records...
+		struct header
+		{
+			char magic_[4];				// GHST
+			std::uint16_t version_;
+			std::uint16_t recordSize_;
+			std::uint32_t opcodes_;		// entries in the opcode table
+			std::uint32_t flags_;
+			std::uint64_t records_;		// record slots including payload, zero when still being written
+			std::uint64_t reserved_;
+		};
+
+		// the op of an action as in script syntax, records refer to ops by their index in the table...
+		struct opcode
+		{
+			char name_[8];
+		};
+
+		// one action. Text (exec programs and typed strings) has its length in a_ and is followed by payload slots
+		// holding the bytes...
+		struct record
+		{
+			std::uint8_t op_;
+			std::uint8_t arg_;			// mouse button or key
+			std::uint16_t reserved_;
+			std::int32_t a_, b_, c_;
+		};
+
+		static_assert(sizeof(header) == 32, "binary header must be 32 bytes");
+		static_assert(sizeof(record) == 16, "binary records must be 16 bytes");
+
+		// slots needed for some text...
+		inline std::uint64_t payload(std::uint64_t length)
+		{
+			return (length + sizeof(record) - 1) / sizeof(record);
+		}
+	}
+
+	class plan;
+
 	// ui action
 	class injectable
 	{
@@ -66,6 +253,15 @@ namespace ghost
 		virtual std::string args() const = 0;
 		virtual std::string op() const = 0;
 
+		// the op as its index in ID::str, actions without one of their own are CairoElephant...
+		virtual unsigned int id() const { return ID::CairoElephant; }
+
+		// lower this action into a plan ahead of time, actions which cannot are called as they are when the plan is played...
+		virtual bool compile(plan&) const { return false; }
+
+		// describe this action as a binary record, text is any payload which follows it...
+		virtual bool encode(binary::record&, std::string&) const { return false; }
+
 		std::string syntax() const
 		{
 			std::ostringstream oss;
@@ -79,768 +275,5996 @@ namespace ghost
 
 	typedef std::shared_ptr<injectable> action;
 
-	namespace program
+	// where injected input ends up. Every action sends its native input records through the current backend...
+	class backend
 	{
-		class exec : public injectable
-		{
-			std::string program_;
-			PROCESS_INFORMATION processInfo_;
-		public:
-			exec(const std::string& program)
-				: program_(program)
-			{
-			}
+	public:
+		virtual ~backend() {}
 
-			//std::string op() const { return ID::str[ID::Exec]; }
-			std::string op() const { return "exec"; }
-			std::string args() const { return program_; }
+		// send count records, returns the number accepted...
+		virtual unsigned int send(const INPUT* inputs, unsigned int count) = 0;
 
-			void run()
-			{
-				if (program_.empty())
-				{
-					// we do not invoke programs...
-				}
-				else
-				{
-					STARTUPINFO info = { sizeof(info) };
-					LPSTR s = const_cast<char *>(program_.c_str());
-					if (!CreateProcess(NULL, s, NULL, NULL, TRUE, 0, NULL, NULL, &info, &processInfo_))
-						std::exception("Unable to start program...");
-				}
-				
-			}
-			void inject() const
-			{
+		// the size of the primary screen absolute mouse coordinates are mapped to...
+		virtual int width() const = 0;
+		virtual int height() const = 0;
 
-			}
-			HANDLE handle() 
+		// whether a top level window with this utf-8 title is open, or has the focus. Backends with no windows to
+		// look at say every window is open and focused...
+		virtual bool window(const char*, bool) const { return true; }
+
+		// the backend for this thread, a scope if one is active otherwise the process default...
+		static backend& current();
+
+		// replace the process default, the backend must outlive its use...
+		static void install(backend& b);
+
+		// bumped whenever the screen geometry of any backend may have changed, cached geometry is rebuilt when it moves...
+		static unsigned int revision() { return revisions().load(std::memory_order_acquire); }
+		static void invalidate() { revisions().fetch_add(1, std::memory_order_acq_rel); }
+
+		// use a backend on this thread for the lifetime of the scope...
+		class scope
+		{
+			backend* previous_;
+		public:
+			scope(backend& b)
+				: previous_(active())
 			{
-				if (program_.empty())
-				{
-					return NULL;
-				}
-				else
-					return processInfo_.hProcess; 
+				active() = &b;
 			}
-			DWORD threadID()
+			~scope()
 			{
-				if (program_.empty())
-				{
-					return 0;
-				}
-				else
-					return processInfo_.dwThreadId;
+				active() = previous_;
 			}
 
-			void wait()
-			{
-				if (program_.empty())
-				{
+		private:
+			scope(const scope&);
+			scope& operator=(const scope&);
+		};
 
-				}
-				else if (processInfo_.hProcess != NULL)
-					WaitForSingleObject(processInfo_.hProcess, INFINITE);
-			}
-			void terminate()
+	private:
+		static backend*& active()
+		{
+			static thread_local backend* b = nullptr;
+			return b;
+		}
+		static std::atomic<backend*>& installed()
+		{
+			static std::atomic<backend*> b(nullptr);
+			return b;
+		}
+		static std::atomic<unsigned int>& revisions()
+		{
+			static std::atomic<unsigned int> r(0);
+			return r;
+		}
+	};
+
+#ifdef GHOST_WINDOWS
+	namespace impl
+	{
+		static LRESULT CALLBACK displayProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+		{
+			if (msg == WM_DISPLAYCHANGE || (msg == WM_SETTINGCHANGE && wParam == SPI_SETWORKAREA))
+				backend::invalidate();
+#ifdef WM_DPICHANGED
+			else if (msg == WM_DPICHANGED)
+				backend::invalidate();
+#endif
+			return DefWindowProc(hwnd, msg, wParam, lParam);
+		}
+
+		// display changes are only broadcast to top level windows, so keep a hidden one on its own thread for the life of the process...
+		inline void listenForDisplayChanges()
+		{
+			static std::once_flag once;
+			std::call_once(once, []()
 			{
-				if (program_.empty())
+				std::thread([]()
 				{
+					WNDCLASSA wc = {};
+					wc.lpfnWndProc = displayProc;
+					wc.hInstance = GetModuleHandle(NULL);
+					wc.lpszClassName = "ghost_display";
+					RegisterClassA(&wc);
+
+					HWND hwnd = CreateWindowExA(0, wc.lpszClassName, "", WS_POPUP, 0, 0, 0, 0, NULL, NULL, wc.hInstance, NULL);
+					if (hwnd == NULL)
+						return;
 
-				}
-				else if (processInfo_.hProcess != NULL)
-				{
-					CloseHandle(processInfo_.hProcess);
-					CloseHandle(processInfo_.hThread);
-				}
-			}
-		};
+					MSG msg;
+					while (GetMessage(&msg, NULL, 0, 0) > 0)
+						DispatchMessage(&msg);
+				}).detach();
+			});
+		}
+	}
 
-		// actions
-		class wait : public injectable
+	// inject into the desktop via SendInput...
+	class sendinput : public backend
+	{
+	public:
+		sendinput()
 		{
-			unsigned int millisecs_;
-		public:
-			wait(const std::string& args) { std::istringstream iss; iss >> millisecs_; }
-			wait(unsigned int millisecs) : millisecs_(millisecs) {}
+			impl::listenForDisplayChanges();
+		}
 
-			//std::string op() const { return ID::str[ID::Wait]; }
-			std::string op() const { return "w"; }
-			std::string args() const { return std::to_string(millisecs_); }
+		unsigned int send(const INPUT* inputs, unsigned int count)
+		{
+			return SendInput(count, const_cast<INPUT*>(inputs), sizeof(INPUT));
+		}
 
-			void inject() const
+		int width() const { return GetSystemMetrics(SM_CXSCREEN); }
+		int height() const { return GetSystemMetrics(SM_CYSCREEN); }
+
+		bool window(const char* title, bool focused) const
+		{
+			WCHAR wide[512];
+			if (!MultiByteToWideChar(CP_UTF8, 0, title, -1, wide, 512))
+				return false;
+			if (!focused)
+				return FindWindowW(NULL, wide) != NULL;
+
+			WCHAR text[512];
+			HWND foreground = GetForegroundWindow();
+			return foreground && GetWindowTextW(foreground, text, 512) && lstrcmpW(text, wide) == 0;
+		}
+	};
+#endif
+
+	// in memory sink, counts everything sent and keeps the most recent records in a ring. Sending is lock free
+	// and safe from any number of threads, reading the ring is only meaningful once the senders are quiet...
+	class loopback : public backend
+	{
+		std::vector<INPUT> ring_;
+		std::size_t mask_;
+		std::atomic<std::uint64_t> sends_;
+		std::atomic<std::uint64_t> inputs_;
+		std::atomic<int> width_, height_;	// resized while replays read them
+
+		struct windows
+		{
+			mutable std::mutex mutex_;
+			std::vector<std::string> open_;
+			std::string focused_;
+		} windows_;
+
+	public:
+		// capacity is rounded up to a power of two, zero keeps nothing and just counts...
+		loopback(std::size_t capacity = 4096, int width = 1920, int height = 1080)
+			: mask_(0), sends_(0), inputs_(0), width_(width), height_(height)
+		{
+			invalidate();
+			if (capacity)
 			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(millisecs_));
+				std::size_t size = 1;
+				while (size < capacity)
+					size <<= 1;
+				ring_.resize(size);
+				mask_ = size - 1;
 			}
-		};
+		}
+
+		unsigned int send(const INPUT* inputs, unsigned int count)
+		{
+			std::uint64_t first = inputs_.fetch_add(count, std::memory_order_relaxed);
+			if (!ring_.empty())
+				for (unsigned int i = 0; i < count; ++i)
+					ring_[static_cast<std::size_t>(first + i) & mask_] = inputs[i];
+			sends_.fetch_add(1, std::memory_order_relaxed);
+			return count;
+		}
+
+		int width() const { return width_.load(std::memory_order_relaxed); }
+		int height() const { return height_.load(std::memory_order_relaxed); }
+
+		// change the screen size, as a display change would...
+		void resize(int width, int height)
+		{
+			width_.store(width, std::memory_order_relaxed);
+			height_.store(height, std::memory_order_relaxed);
+			invalidate();
+		}
+
+		// windows for waits to find, there are none until shown. The last window shown or focused has the focus...
+		void show(const std::string& title)
+		{
+			std::lock_guard<std::mutex> lock(windows_.mutex_);
+			windows_.open_.push_back(title);
+			windows_.focused_ = title;
+		}
+
+		void hide(const std::string& title)
+		{
+			std::lock_guard<std::mutex> lock(windows_.mutex_);
+			std::vector<std::string>::iterator itr = std::find(windows_.open_.begin(), windows_.open_.end(), title);
+			if (itr != windows_.open_.end())
+				windows_.open_.erase(itr);
+			if (windows_.focused_ == title)
+				windows_.focused_.clear();
+		}
 
-		static action factory(const std::string& op, const std::string& args)
+		void focus(const std::string& title)
 		{
-			action newAction;
+			std::lock_guard<std::mutex> lock(windows_.mutex_);
+			windows_.focused_ = title;
+		}
+
+		bool window(const char* title, bool focused) const
+		{
+			std::lock_guard<std::mutex> lock(windows_.mutex_);
+			if (focused)
+				return windows_.focused_ == title && std::find(windows_.open_.begin(), windows_.open_.end(), title) != windows_.open_.end();
+			return std::find(windows_.open_.begin(), windows_.open_.end(), title) != windows_.open_.end();
+		}
+
+		// number of send calls and records received...
+		std::uint64_t sends() const { return sends_.load(std::memory_order_relaxed); }
+		std::uint64_t inputs() const { return inputs_.load(std::memory_order_relaxed); }
+
+		// the most recent records, oldest first...
+		std::vector<INPUT> recent() const
+		{
+			std::uint64_t total = inputs();
+			std::size_t kept = static_cast<std::size_t>((std::min<std::uint64_t>)(total, ring_.size()));
+			std::vector<INPUT> result(kept);
+			for (std::size_t i = 0; i < kept; ++i)
+				result[i] = ring_[static_cast<std::size_t>(total - kept + i) & mask_];
+			return result;
+		}
 
-			if (op == "w")
-				newAction.reset(new wait(args));
-			else if (op == "exec")
-				newAction.reset(new exec(args));
+		void reset()
+		{
+			sends_.store(0, std::memory_order_relaxed);
+			inputs_.store(0, std::memory_order_relaxed);
+		}
 
-			return newAction;
+		~loopback()
+		{
+			// another backend may be given this address...
+			invalidate();
 		}
+	};
 
+	inline backend& backend::current()
+	{
+		if (backend* b = active())
+			return *b;
+		if (backend* b = installed().load(std::memory_order_acquire))
+			return *b;
+
+#ifdef GHOST_WINDOWS
+		static sendinput fallback;
+#else
+		static loopback fallback;
+#endif
+		return fallback;
 	}
-	
 
-	// mouse actions
-	namespace mouse
+	inline void backend::install(backend& b)
 	{
-		enum button
+		installed().store(&b, std::memory_order_release);
+	}
+
+	// records spans of time, what was happening and when, into buffers allocated up front for each thread which
+	// traces. Nothing is traced until a tracer is started, then replays, waits, programs run and hook callbacks are.
+	// The spans can be written out in the chrome trace event format, which chrome://tracing and Perfetto load.
+	// Like the loopback, reading is only meaningful once the traced threads are quiet...
+	class tracer
+	{
+	public:
+		typedef std::chrono::steady_clock clock;
+
+		// names and categories are not copied, they must outlive the tracer...
+		struct span
 		{
-			None = 0,
-			Left,
-			Right,
-			Middle,
-			X,
-			CairoElephant
+			const char* name_;
+			const char* category_;
+			std::int64_t begin_, end_;	// nanoseconds from when the tracer was made, end is zero while open
+			const char* arg_;			// the name of value, if it has one
+			std::int64_t value_;
 		};
 
-		static const std::vector<std::string> buttonStr({
-			"m",
-			"ml",
-			"mr",
-			"mm",
-			"mx",
-			"ce"
-			});
+		// capacity is spans for each thread, those which do not fit are dropped...
+		explicit tracer(std::size_t capacity = 1 << 16)
+			: capacity_((std::max<std::size_t>)(capacity, 1)), id_(ids().fetch_add(1, std::memory_order_relaxed) + 1), epoch_(clock::now()), dropped_(0)
+		{
+		}
 
-		struct screen
+		~tracer()
 		{
-			screen()
-			{
-				RECT desktop;
-				// Get a handle to the desktop window
-				const HWND hDesktop = GetDesktopWindow();
-				// Get the size of screen to the variable desktop
-				GetWindowRect(hDesktop, &desktop);
+			stop();
+		}
 
-				left_ = desktop.left;
-				right_ = desktop.right;
-				top_ = desktop.top;
-				bottom_ = desktop.bottom;
-			}
+		// trace every thread until stopped, only one tracer traces at a time. The buffer for this thread is made now,
+		// others when they first trace...
+		void start()
+		{
+			local();
+			installed().store(this, std::memory_order_release);
+		}
+		void stop()
+		{
+			tracer* self = this;
+			installed().compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+		}
 
-			int width() const { return abs(right_ - left_); }
-			int height() const { return abs(top_ - bottom_); }
+		// the tracer tracing, if any...
+		static tracer* active() { return installed().load(std::memory_order_acquire); }
 
-			int left_, right_, top_, bottom_;
-		};
+		// begin a span on this thread, null if there is no room for it...
+		span* open(const char* name, const char* category, const char* arg = nullptr, std::int64_t value = 0)
+		{
+			return open(name, category, now(), arg, value);
+		}
 
-		class base : public injectable
+		span* open(const char* name, const char* category, std::int64_t begin, const char* arg = nullptr, std::int64_t value = 0)
 		{
-		public:
-			base()
-				: button_(button::None) {}
-			base(const button& button)
-				: button_(button) {}
-			base(const button& button, int x, int y)
-				: button_(button), x_(x), y_(y) 
+			buffer& b = local();
+			std::size_t used = b.used_.load(std::memory_order_relaxed);
+			if (used == b.spans_.size())
 			{
-				int g = 0;
-				++g;
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
 			}
+			span& s = b.spans_[used];
+			s.name_ = name;
+			s.category_ = category;
+			s.begin_ = begin;
+			s.end_ = 0;
+			s.arg_ = arg;
+			s.value_ = value;
+			b.used_.store(used + 1, std::memory_order_release);
+			return &s;
+		}
 
-			std::string args() const
-			{
-				std::ostringstream oss;
-				oss << buttonStr[static_cast<unsigned int>(button_)] << " " << x_ << " " << y_;
-				return oss.str();
+		void close(span* s) { close(s, now()); }
+		void close(span* s, std::int64_t end)
+		{
+			if (s)
+				s->end_ = (std::max)(end, s->begin_ + 1);
+		}
+
+		// nanoseconds since the tracer was made...
+		std::int64_t now() const { return since(clock::now()); }
+		std::int64_t since(clock::time_point t) const { return std::chrono::duration_cast<std::chrono::nanoseconds>(t - epoch_).count(); }
+
+		std::uint64_t size() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::uint64_t total = 0;
+			for (std::vector<std::unique_ptr<buffer>>::const_iterator itr = buffers_.begin(); itr != buffers_.end(); ++itr)
+				total += (*itr)->used_.load(std::memory_order_acquire);
+			return total;
+		}
+		std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+		// the spans as a chrome trace, threads are numbered in the order they first traced...
+		std::string json() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::ostringstream oss;
+			oss.precision(3);
+			oss << std::fixed << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+			bool first = true;
+			for (std::size_t t = 0; t < buffers_.size(); ++t)
+			{
+				oss << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t + 1
+					<< ",\"args\":{\"name\":\"ghost " << t + 1 << "\"}}";
+				first = false;
+
+				std::size_t used = buffers_[t]->used_.load(std::memory_order_acquire);
+				for (std::size_t i = 0; i < used; ++i)
+				{
+					const span& s = buffers_[t]->spans_[i];
+					std::int64_t end = s.end_ ? s.end_ : s.begin_;
+					oss << ",\n{\"name\":\"" << s.name_ << "\",\"cat\":\"" << s.category_ << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t + 1
+						<< ",\"ts\":" << s.begin_ / 1000.0 << ",\"dur\":" << (end - s.begin_) / 1000.0;
+					if (s.arg_)
+						oss << ",\"args\":{\"" << s.arg_ << "\":" << s.value_ << "}";
+					oss << "}";
+				}
+			}
+			oss << "\n]}\n";
+			return oss.str();
+		}
+
+		void write(const std::string& path) const
+		{
+			std::string trace = json();
+			std::FILE* file = std::fopen(path.c_str(), "wb");
+			if (!file)
+				throw std::runtime_error("Unable to write trace " + path);
+			std::size_t written = std::fwrite(trace.data(), 1, trace.size(), file);
+			std::fclose(file);
+			if (written != trace.size())
+				throw std::runtime_error("Unable to write trace " + path);
+		}
+
+		// a span over a scope, if anything is tracing...
+		class scope
+		{
+			tracer* tracer_;
+			span* span_;
+		public:
+			scope(const char* name, const char* category, const char* arg = nullptr, std::int64_t value = 0)
+				: tracer_(active()), span_(tracer_ ? tracer_->open(name, category, arg, value) : nullptr) {}
+			~scope()
+			{
+				if (span_)
+					tracer_->close(span_);
+			}
+
+		private:
+			scope(const scope&);
+			scope& operator=(const scope&);
+		};
+
+	private:
+		struct buffer
+		{
+			explicit buffer(std::size_t capacity) : spans_(capacity), used_(0) {}
+			std::vector<span> spans_;
+			std::atomic<std::size_t> used_;
+		};
+
+		// this thread's buffer, made the first time it traces...
+		buffer& local()
+		{
+			struct cache
+			{
+				std::uint64_t id_;
+				buffer* buffer_;
+			};
+			static thread_local cache c = { 0, nullptr };
+			if (c.id_ != id_)
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				buffers_.push_back(std::unique_ptr<buffer>(new buffer(capacity_)));
+				c.id_ = id_;
+				c.buffer_ = buffers_.back().get();
+			}
+			return *c.buffer_;
+		}
+
+		static std::atomic<tracer*>& installed()
+		{
+			static std::atomic<tracer*> t(nullptr);
+			return t;
+		}
+		static std::atomic<std::uint64_t>& ids()
+		{
+			static std::atomic<std::uint64_t> i(0);
+			return i;
+		}
+
+		tracer(const tracer&);
+		tracer& operator=(const tracer&);
+
+		std::size_t capacity_;
+		std::uint64_t id_;
+		clock::time_point epoch_;
+		std::atomic<std::uint64_t> dropped_;
+		mutable std::mutex mutex_;
+		std::vector<std::unique_ptr<buffer>> buffers_;
+	};
+
+	namespace impl
+	{
+		// lock free ring for exactly one producer and one consumer. The two indices live on their own cache lines so
+		// the hook and the consumer thread do not fight over them...
+		template<typename T>
+		class ring
+		{
+		public:
+			// capacity is rounded up to a power of two...
+			explicit ring(std::size_t capacity)
+				: mask_(0), head_(0), tail_(0), dropped_(0)
+			{
+				std::size_t size = 1;
+				while (size < capacity)
+					size <<= 1;
+				slots_.resize(size);
+				mask_ = size - 1;
+			}
+
+			// producer side, never blocks. A full ring drops the item and counts it...
+			bool push(const T& item)
+			{
+				std::size_t tail = tail_.load(std::memory_order_relaxed);
+				if (tail - head_.load(std::memory_order_acquire) > mask_)
+				{
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				slots_[tail & mask_] = item;
+				tail_.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+
+			// consumer side...
+			bool pop(T& item)
+			{
+				std::size_t head = head_.load(std::memory_order_relaxed);
+				if (head == tail_.load(std::memory_order_acquire))
+					return false;
+				item = slots_[head & mask_];
+				head_.store(head + 1, std::memory_order_release);
+				return true;
+			}
+
+			bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+			std::size_t capacity() const { return slots_.size(); }
+			std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+		private:
+			std::vector<T> slots_;
+			std::size_t mask_;
+			char pad0_[64];
+			std::atomic<std::size_t> head_;
+			char pad1_[64];
+			std::atomic<std::size_t> tail_;
+			char pad2_[64];
+			std::atomic<std::uint64_t> dropped_;
+		};
+	}
+
+	// diagnostics as records rather than text. Each thread which logs writes to a ring of its own without locking or
+	// formatting anything, and whoever reads the log formats it. Entries less severe than GHOST_LOG_LEVEL are
+	// compiled out, and of those left the ones less severe than the level set at run time cost a load and a compare...
+	class logger
+	{
+	public:
+		enum severity
+		{
+			Trace = 0,
+			Debug,
+			Info,
+			Warning,
+			Error,
+			Off
+		};
+
+		struct entry
+		{
+			std::int64_t time_;			// steady clock nanoseconds
+			const char* what_;			// a literal
+			binary::record action_;		// the action it is about, op CairoElephant if none. Text is not kept
+			std::uint32_t session_;		// zero outside a session
+			std::uint16_t thread_;		// the ring it came through, rings are numbered as threads first log
+			std::uint8_t severity_;
+			bool args_;					// whether the action has its args or only its op
+		};
+
+		// rings hold capacity entries, those which do not fit are dropped and counted...
+		explicit logger(std::size_t capacity = 4096)
+			: id_(++created()), capacity_(capacity), dropped_(0), listening_(false),
+#ifdef GHOST_ENABLE_MESSAGES
+			level_(Debug)
+#else
+			level_(Warning)
+#endif
+		{
+		}
+
+		~logger()
+		{
+			stop();
+		}
+
+		// the process wide log...
+		static logger& instance()
+		{
+			static logger l;
+			return l;
+		}
+
+		void level(severity s) { level_.store(s, std::memory_order_relaxed); }
+		severity level() const { return static_cast<severity>(level_.load(std::memory_order_relaxed)); }
+
+		bool enabled(severity s) const
+		{
+			return s >= GHOST_LOG_LEVEL && s != Off && s >= level_.load(std::memory_order_relaxed);
+		}
+
+		// log to the process wide log, if the entry gets through both filters...
+		template<severity S>
+		static void write(const char* what)
+		{
+			write<S>(what, nothing());
+		}
+
+		template<severity S>
+		static void write(const char* what, const binary::record& action)
+		{
+			if (S >= GHOST_LOG_LEVEL && S != Off && instance().enabled(S))
+				instance().add(S, what, action, current());
+		}
+
+		template<severity S>
+		static void write(const char* what, const binary::record& action, std::uint32_t session)
+		{
+			if (S >= GHOST_LOG_LEVEL && S != Off && instance().enabled(S))
+				instance().add(S, what, action, session);
+		}
+
+		// the action is only encoded if the entry gets through...
+		template<severity S>
+		static void write(const char* what, const injectable& action)
+		{
+			if (S >= GHOST_LOG_LEVEL && S != Off && instance().enabled(S))
+				instance().add(S, what, about(action), current());
+		}
+
+		// whether an entry would get through both filters, for entries which take work to make...
+		template<severity S>
+		static bool wants()
+		{
+			return S >= GHOST_LOG_LEVEL && S != Off && instance().enabled(S);
+		}
+
+		// an action as an entry holds it, check the entry is wanted first as the action is encoded...
+		static binary::record about(const injectable& a)
+		{
+			static thread_local std::string text;
+			binary::record r = nothing();
+			a.encode(r, text);
+			return r;
+		}
+
+		// without filtering, never blocks...
+		void add(severity s, const char* what, const binary::record& action, std::uint32_t session, bool args = true)
+		{
+			slot* own = local();
+			if (!own)
+			{
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			entry e;
+			e.time_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			e.what_ = what;
+			e.action_ = action;
+			e.session_ = session;
+			e.thread_ = own->index_;
+			e.severity_ = static_cast<std::uint8_t>(s);
+			e.args_ = args;
+			own->entries_.push(e);
+		}
+
+		// hand everything logged so far to f in the order it was logged, one reader at a time. Returns how many.
+		// f is called without the rings locked, so it may log...
+		template<typename F>
+		std::size_t drain(F f)
+		{
+			std::lock_guard<std::mutex> reading(reading_);
+			pending_.clear();
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (std::vector<std::shared_ptr<slot>>::iterator itr = slots_.begin(); itr != slots_.end(); ++itr)
+				{
+					entry e;
+					while ((*itr)->entries_.pop(e))
+						pending_.push_back(e);
+				}
+			}
+			std::stable_sort(pending_.begin(), pending_.end(), [](const entry& a, const entry& b) { return a.time_ < b.time_; });
+			for (std::vector<entry>::const_iterator itr = pending_.begin(); itr != pending_.end(); ++itr)
+				f(*itr);
+			return pending_.size();
+		}
+
+		std::uint64_t dropped() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::uint64_t total = dropped_.load(std::memory_order_relaxed);
+			for (std::vector<std::shared_ptr<slot>>::const_iterator itr = slots_.begin(); itr != slots_.end(); ++itr)
+				total += (*itr)->entries_.dropped();
+			return total;
+		}
+
+		// as a line of text...
+		static std::string format(const entry& e);
+
+		// drain to f on a thread of its own every interval, and once more on stop...
+		void listen(std::function<void(const entry&)> f, std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+		{
+			stop();
+			listening_.store(true, std::memory_order_release);
+			listener_ = std::thread([this, f, interval]()
+			{
+				while (listening_.load(std::memory_order_acquire))
+				{
+					drain(f);
+					std::this_thread::sleep_for(interval);
+				}
+				drain(f);
+			});
+		}
+
+#ifdef GHOST_ENABLE_MESSAGES
+		// formatted, to messageCallback...
+		void listen(std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+		{
+			listen([](const entry& e)
+			{
+				if (ghost::messageCallback)
+					ghost::messageCallback(format(e));
+			}, interval);
+		}
+#endif
+
+		void stop()
+		{
+			listening_.store(false, std::memory_order_release);
+			if (listener_.joinable())
+				listener_.join();
+		}
+
+		// entries written on this thread without a session are from this one for the life of the scope...
+		class scope
+		{
+			std::uint32_t previous_;
+		public:
+			explicit scope(std::uint32_t session)
+				: previous_(current())
+			{
+				current() = session;
+			}
+			~scope()
+			{
+				current() = previous_;
+			}
+
+		private:
+			scope(const scope&);
+			scope& operator=(const scope&);
+		};
+
+		static std::uint32_t& current()
+		{
+			static thread_local std::uint32_t session = 0;
+			return session;
+		}
+
+		// an entry about no action...
+		static const binary::record& nothing()
+		{
+			static const binary::record r = { static_cast<std::uint8_t>(ID::CairoElephant), 0, 0, 0, 0, 0 };
+			return r;
+		}
+
+	private:
+		// a ring and whether a thread is writing to it. A thread gives its ring back when it ends, so threads which
+		// come and go reuse rings rather than adding more. Rings are shared with the threads holding them, which
+		// may give them back after the logger has gone...
+		struct slot
+		{
+			slot(std::size_t capacity, std::uint16_t index) : entries_(capacity), owned_(true), index_(index) {}
+			impl::ring<entry> entries_;
+			std::atomic<bool> owned_;
+			std::uint16_t index_;
+		};
+
+		// this thread's ring, claimed the first time it logs. A thread holds one ring at a time, logging to another
+		// logger gives back the ring it held. Loggers are told apart by id rather than address, which a new logger
+		// may reuse...
+		slot* local()
+		{
+			struct claim
+			{
+				std::uint64_t logger_;
+				std::shared_ptr<slot> slot_;
+				~claim()
+				{
+					if (slot_)
+						slot_->owned_.store(false, std::memory_order_release);
+				}
+			};
+			static thread_local claim c = { 0, nullptr };
+			if (c.logger_ == id_)
+				return c.slot_.get();
+
+			if (c.slot_)
+				c.slot_->owned_.store(false, std::memory_order_release);
+			c.logger_ = id_;
+			c.slot_.reset();
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (std::vector<std::shared_ptr<slot>>::iterator itr = slots_.begin(); itr != slots_.end() && !c.slot_; ++itr)
+			{
+				bool owned = false;
+				if ((*itr)->owned_.compare_exchange_strong(owned, true, std::memory_order_acq_rel))
+					c.slot_ = *itr;
+			}
+			if (!c.slot_ && slots_.size() < 0xffff)
+			{
+				slots_.push_back(std::make_shared<slot>(capacity_, static_cast<std::uint16_t>(slots_.size())));
+				c.slot_ = slots_.back();
+			}
+			return c.slot_.get();
+		}
+
+		static std::atomic<std::uint64_t>& created()
+		{
+			static std::atomic<std::uint64_t> count(0);
+			return count;
+		}
+
+		logger(const logger&);
+		logger& operator=(const logger&);
+
+		std::uint64_t id_;
+		std::size_t capacity_;
+		std::atomic<std::uint64_t> dropped_;
+		std::atomic<bool> listening_;
+		std::atomic<int> level_;
+		mutable std::mutex mutex_;	// the rings
+		std::mutex reading_;		// the one reader draining
+		std::vector<std::shared_ptr<slot>> slots_;
+		std::vector<entry> pending_;
+		std::thread listener_;
+	};
+
+	// counts of values in buckets which widen with the values, as HDR histograms do. Values below 32 have a bucket
+	// each, above that every power of two is split into 32 so a value is never more than 3% from its bucket. Nothing
+	// is allocated until the first value is recorded...
+	class histogram
+	{
+	public:
+		histogram()
+			: count_(0), total_(0), least_(0), most_(0) {}
+
+		void record(std::uint64_t value, std::uint64_t times = 1)
+		{
+			if (counts_.empty())
+				counts_.resize(buckets);
+			if (value > limit)
+				value = limit;
+			counts_[bucket(value)] += times;
+			least_ = count_ ? (std::min)(least_, value) : value;
+			most_ = (std::max)(most_, value);
+			total_ += value * times;
+			count_ += times;
+		}
+
+		void merge(const histogram& other)
+		{
+			if (!other.count_)
+				return;
+			if (counts_.empty())
+				counts_.resize(buckets);
+			for (unsigned int b = 0; b < buckets; ++b)
+				counts_[b] += other.counts_[b];
+			least_ = count_ ? (std::min)(least_, other.least_) : other.least_;
+			most_ = (std::max)(most_, other.most_);
+			total_ += other.total_;
+			count_ += other.count_;
+		}
+
+		std::uint64_t count() const { return count_; }
+		std::uint64_t least() const { return least_; }
+		std::uint64_t most() const { return most_; }
+		double mean() const { return count_ ? static_cast<double>(total_) / count_ : 0.0; }
+
+		// the value percent of those recorded are at or below, to within its bucket...
+		std::uint64_t percentile(double percent) const
+		{
+			if (!count_)
+				return 0;
+			std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(percent / 100.0 * count_));
+			rank = (std::max<std::uint64_t>)(rank, 1);
+			std::uint64_t seen = 0;
+			for (unsigned int b = 0; b < buckets; ++b)
+			{
+				seen += counts_[b];
+				if (seen >= rank)
+					return (std::max)((std::min)(highest(b), most_), least_);
+			}
+			return most_;
+		}
+
+		void reset()
+		{
+			std::fill(counts_.begin(), counts_.end(), 0);
+			count_ = total_ = least_ = most_ = 0;
+		}
+
+	private:
+		static const unsigned int precision = 5;
+		static const std::uint64_t limit = (std::uint64_t(1) << 48) - 1;
+		static const unsigned int buckets = (48 - precision + 1) << precision;
+
+		static unsigned int bucket(std::uint64_t value)
+		{
+			if (value < (1u << precision))
+				return static_cast<unsigned int>(value);
+#if defined(_MSC_VER) && defined(_WIN64)
+			unsigned long magnitude;
+			_BitScanReverse64(&magnitude, value);
+#elif defined(__GNUC__)
+			unsigned int magnitude = 63 - static_cast<unsigned int>(__builtin_clzll(value));
+#else
+			unsigned int magnitude = precision;
+			while (value >> (magnitude + 1))
+				++magnitude;
+#endif
+			unsigned int shift = static_cast<unsigned int>(magnitude) - precision;
+			return ((shift + 1) << precision) + static_cast<unsigned int>((value >> shift) - (1u << precision));
+		}
+
+		// the largest value in a bucket...
+		static std::uint64_t highest(unsigned int b)
+		{
+			if (b < (1u << precision))
+				return b;
+			unsigned int shift = (b >> precision) - 1;
+			std::uint64_t lowest = static_cast<std::uint64_t>((1u << precision) + (b & ((1u << precision) - 1))) << shift;
+			return lowest + (std::uint64_t(1) << shift) - 1;
+		}
+
+		std::vector<std::uint64_t> counts_;
+		std::uint64_t count_;
+		std::uint64_t total_;
+		std::uint64_t least_, most_;
+	};
+
+	// what a replay measured, returned from play when the playback asks for it. Each op has a count of the actions
+	// played and a histogram of how long the calls which sent their input took, up to the next call or wait. Drift is
+	// how late each action began against its schedule, overshoot how late each wait ended. Durations are in
+	// nanoseconds...
+	class playStats
+	{
+	public:
+		typedef std::chrono::steady_clock clock;
+
+		playStats()
+			: enabled_(false), actions_(0), elapsed_(0) {}
+
+		// false when nothing was measured...
+		bool enabled() const { return enabled_; }
+
+		std::uint64_t actions() const { return actions_; }
+		clock::duration elapsed() const { return elapsed_; }
+
+		// by op, as an index in ID::str...
+		std::uint64_t count(unsigned int id) const { return id < ops_.size() ? ops_[id].count_ : 0; }
+		const histogram& latency(unsigned int id) const { return id < ops_.size() ? ops_[id].latency_ : none(); }
+
+		// every call...
+		const histogram& latency() const { return latency_; }
+		const histogram& drift() const { return drift_; }
+		const histogram& overshoot() const { return overshoot_; }
+
+		std::string report() const
+		{
+			std::ostringstream oss;
+			oss << actions_ << " actions in " << std::chrono::duration<double>(elapsed_).count() << "s\n";
+			for (unsigned int id = 0; id < ops_.size(); ++id)
+				if (ops_[id].count_)
+				{
+					oss << (id < ID::CairoElephant ? ID::str[id] : "custom") << " " << ops_[id].count_;
+					if (ops_[id].latency_.count())
+						line(oss, ops_[id].latency_);
+					oss << "\n";
+				}
+			oss << "latency"; line(oss, latency_); oss << "\n";
+			oss << "drift"; line(oss, drift_); oss << "\n";
+			oss << "overshoot"; line(oss, overshoot_); oss << "\n";
+			return oss.str();
+		}
+
+		// measuring, from the timeline...
+		void begin()
+		{
+			enabled_ = true;
+			ops_.resize(ID::CairoElephant + 1);
+			start_ = clock::now();
+		}
+		void end()
+		{
+			elapsed_ = clock::now() - start_;
+			latency_.reset();
+			for (unsigned int id = 0; id < ops_.size(); ++id)
+				latency_.merge(ops_[id].latency_);
+		}
+
+		void begun(unsigned int id, clock::duration drift)
+		{
+			begun(id);
+			drift_.record(nanosecs(drift));
+		}
+		void begun(unsigned int id)
+		{
+			++ops_[(std::min)(id, static_cast<unsigned int>(ID::CairoElephant))].count_;
+			++actions_;
+		}
+		void drifted(clock::duration drift, std::uint64_t times) { drift_.record(nanosecs(drift), times); }
+		void took(unsigned int id, clock::duration latency)
+		{
+			if (id == ID::Wait)
+				return;
+			ops_[(std::min)(id, static_cast<unsigned int>(ID::CairoElephant))].latency_.record(nanosecs(latency));
+		}
+		void late(clock::duration overshoot) { overshoot_.record(nanosecs(overshoot)); }
+
+	private:
+		struct op
+		{
+			op() : count_(0) {}
+			std::uint64_t count_;
+			histogram latency_;
+		};
+
+		static std::uint64_t nanosecs(clock::duration d)
+		{
+			return d.count() > 0 ? static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()) : 0;
+		}
+
+		static const histogram& none()
+		{
+			static const histogram h;
+			return h;
+		}
+
+		static void line(std::ostringstream& oss, const histogram& h)
+		{
+			oss << " mean " << h.mean() / 1000.0 << "us p50 " << h.percentile(50) / 1000.0 << "us p99 " << h.percentile(99) / 1000.0
+				<< "us max " << h.most() / 1000.0 << "us";
+		}
+
+		bool enabled_;
+		std::uint64_t actions_;
+		clock::time_point start_;
+		clock::duration elapsed_;
+		std::vector<op> ops_;
+		histogram latency_;		// every op's, merged as the replay ends
+		histogram drift_;
+		histogram overshoot_;
+	};
+
+	// waits for deadlines by sleeping for most of the time and yielding for the last stretch, which the scheduler
+	// tick would otherwise overshoot. How early to stop sleeping is learned from how late sleeps wake up and is never
+	// more than the spin budget, a budget of zero only sleeps...
+	class pacer
+	{
+	public:
+		typedef std::chrono::steady_clock clock;
+
+		explicit pacer(clock::duration budget = std::chrono::milliseconds(1))
+			: budget_(budget), margin_(budget), waits_(0), overshoot_(0), worst_(0), spun_(0)
+		{
+		}
+
+		// wait until deadline, returns how late it was...
+		clock::duration until(clock::time_point deadline)
+		{
+			clock::time_point now = clock::now();
+			for (;;)
+			{
+				clock::duration remaining = deadline - now;
+				clock::duration early = (std::min)(margin_, budget_);
+				if (remaining <= early)
+					break;
+
+				clock::duration request = remaining - early;
+				std::this_thread::sleep_for(request);
+				clock::time_point woke = clock::now();
+				learn(woke - now - request);
+				now = woke;
+			}
+
+			clock::time_point spinning = now;
+			while (now < deadline)
+			{
+				std::this_thread::yield();
+				now = clock::now();
+			}
+			spun_ += now - spinning;
+
+			clock::duration late = now - deadline;
+			++waits_;
+			overshoot_ += late;
+			worst_ = (std::max)(worst_, late);
+			return late;
+		}
+
+		clock::duration budget() const { return budget_; }
+		void budget(clock::duration b) { budget_ = b; }
+
+		// what was measured, the overshoot past each deadline and the time spent spinning...
+		std::uint64_t waits() const { return waits_; }
+		clock::duration overshoot() const { return overshoot_; }
+		clock::duration worst() const { return worst_; }
+		clock::duration spun() const { return spun_; }
+
+		void reset()
+		{
+			waits_ = 0;
+			overshoot_ = worst_ = spun_ = clock::duration::zero();
+		}
+
+		// the pacer for waits on this thread which are not given one...
+		static pacer& local()
+		{
+			static thread_local pacer p;
+			return p;
+		}
+
+	private:
+		// quick to grow, slow to shrink...
+		void learn(clock::duration late)
+		{
+			if (late > margin_)
+				margin_ = late;
+			else
+				margin_ -= (margin_ - late) / 16;
+		}
+
+		clock::duration budget_;
+		clock::duration margin_;
+		std::uint64_t waits_;
+		clock::duration overshoot_;
+		clock::duration worst_;
+		clock::duration spun_;
+	};
+
+	// how a script or plan is replayed...
+	struct playback
+	{
+		playback()
+			: burst_(0), pacer_(nullptr), measure_(false) {}
+
+		// when non zero, runs of actions with no wait between them are sent in a single submission of up to this
+		// many records. SendInput does not interleave other input with a single submission...
+		std::size_t burst_;
+
+		// paces the waits, the thread's own if null...
+		pacer* pacer_;
+
+		// measure the replay into the playStats play returns, otherwise they are empty...
+		bool measure_;
+	};
+
+	// the clock a replay is scheduled against. While one is running on a thread, waits sleep until a deadline
+	// measured from the start of the replay rather than for a duration, so time lost in one step is made up in
+	// the next instead of adding up...
+	class timeline
+	{
+	public:
+		typedef std::chrono::steady_clock clock;
+
+		explicit timeline(pacer& p = pacer::local(), playStats* stats = nullptr)
+			: pacer_(p), stats_(stats), tracer_(tracer::active()), logging_(logger::wants<logger::Debug>()), replay_(nullptr), open_(nullptr),
+			start_(clock::now()), deadline_(start_), timing_(false), timed_(0), joined_(0), previous_(active())
+		{
+			active() = this;
+			if (stats_)
+				stats_->begin();
+			if (tracer_)
+				replay_ = tracer_->open("play", "replay", tracer_->since(start_));
+		}
+
+		// as a playback says...
+		timeline(const playback& options, playStats& stats)
+			: timeline(options.pacer_ ? *options.pacer_ : pacer::local(), options.measure_ ? &stats : nullptr)
+		{
+		}
+
+		~timeline()
+		{
+			clock::time_point end = clock::now();
+			if (tracer_)
+			{
+				tracer_->close(open_, tracer_->since(end));
+				tracer_->close(replay_, tracer_->since(end));
+			}
+			if (stats_)
+			{
+				ended(end);
+				stats_->end();
+			}
+			active() = previous_;
+		}
+
+		// move the deadline on and sleep until it...
+		void wait(unsigned int millisecs)
+		{
+			if (timing_)
+				ended(clock::now());
+			deadline_ += std::chrono::milliseconds(millisecs);
+			tracer::span* waiting = tracer_ ? tracer_->open("wait", "wait", "ms", millisecs) : nullptr;
+			clock::duration late = pacer_.until(deadline_);
+			if (waiting)
+				tracer_->close(waiting);
+			if (stats_)
+				stats_->late(late);
+		}
+
+		// the action as its own type, so the call need not be virtual...
+		template<typename A>
+		void inject(const A& a)
+		{
+			if (stats_ || tracer_ || logging_)
+				measured(a);
+			else
+				a.inject();
+		}
+
+		// call f, which injects some or all of an action with the op id, timing it when the replay is measured,
+		// tracing it when it is traced and logging it when debug entries are. The entry is about the op alone
+		// unless the action is given. The clock is read once, as f begins, and that reading ends the call before
+		// it, so a call's latency runs until the next begins or the replay waits...
+		template<typename F>
+		void measure(unsigned int id, bool action, F f, const binary::record* about = nullptr)
+		{
+			if (logging_ && action)
+				log(id, about);
+			if (!stats_ && !tracer_)
+			{
+				f();
+				return;
+			}
+			clock::time_point begin = clock::now();
+			if (tracer_)
+				trace(id, begin);
+			if (stats_)
+			{
+				ended(begin);
+				if (action)
+					stats_->begun(id, begin - deadline_);
+				timing_ = id != ID::Wait;
+				timed_ = id;
+				mark_ = begin;
+			}
+			f();
+		}
+
+		// an action which starts without a call of its own. One sent in the same burst began with it and takes
+		// the burst's reading, a wait reads the clock...
+		void begun(unsigned int id)
+		{
+			if (logging_)
+				log(id, nullptr);
+			if (!stats_ && (!tracer_ || id != ID::Wait))
+				return;
+			if (id != ID::Wait && timing_)
+			{
+				stats_->begun(id);
+				++joined_;
+				return;
+			}
+			clock::time_point now = clock::now();
+			if (tracer_ && id == ID::Wait)
+				trace(id, now);
+			if (stats_)
+			{
+				ended(now);
+				stats_->begun(id, now - deadline_);
+			}
+		}
+
+		// the replay waited on the target for as long as it took, the schedule carries on from now rather than
+		// making the time up...
+		void synced()
+		{
+			deadline_ = (std::max)(deadline_, clock::now());
+		}
+
+		clock::time_point start() const { return start_; }
+		clock::time_point deadline() const { return deadline_; }
+
+		// how far behind schedule the replay is now...
+		clock::duration drift() const { return clock::now() - deadline_; }
+
+		// the timeline running on this thread, if any...
+		static timeline* current() { return active(); }
+
+	private:
+		template<typename A>
+		void measured(const A& a)
+		{
+			if (logging_)
+			{
+				binary::record r = logger::about(a);
+				measure(a.id(), true, [&a]() { a.inject(); }, &r);
+			}
+			else
+				measure(a.id(), true, [&a]() { a.inject(); });
+		}
+
+		// the call being timed ended at t, the actions which joined it began when it did...
+		void ended(clock::time_point t)
+		{
+			if (timing_)
+				stats_->took(timed_, t - mark_);
+			if (joined_)
+				stats_->drifted(mark_ - deadline_, joined_);
+			timing_ = false;
+			joined_ = 0;
+		}
+
+		void log(unsigned int id, const binary::record* about)
+		{
+			binary::record r = logger::nothing();
+			r.op_ = static_cast<std::uint8_t>(id);
+			logger::instance().add(logger::Debug, "inject", about ? *about : r, logger::current(), about != nullptr);
+		}
+
+		// each action's span runs until the next begins, so it takes one reading of the clock. Waits within an
+		// action are inside its span, waits of their own have only the wait's...
+		void trace(unsigned int id, clock::time_point begin)
+		{
+			std::int64_t t = tracer_->since(begin);
+			tracer_->close(open_, t);
+			open_ = id == ID::Wait ? nullptr : tracer_->open(id < ID::CairoElephant ? ID::str[id].c_str() : "custom", "inject", t);
+		}
+
+		static timeline*& active()
+		{
+			static thread_local timeline* t = nullptr;
+			return t;
+		}
+
+		timeline(const timeline&);
+		timeline& operator=(const timeline&);
+
+		pacer& pacer_;
+		playStats* stats_;
+		tracer* tracer_;
+		bool logging_;
+		tracer::span* replay_;
+		tracer::span* open_;		// the action injecting
+		clock::time_point start_;
+		clock::time_point deadline_;
+		clock::time_point mark_;	// the last reading, when the call being timed began
+		bool timing_;
+		unsigned int timed_;		// its op
+		std::uint64_t joined_;		// actions sent with it
+		timeline* previous_;
+	};
+
+	// a script lowered ahead of time into one contiguous array of ready to send records plus the waits between them,
+	// playing it only sends the records...
+	class plan
+	{
+	public:
+		enum kind
+		{
+			Send = 0,
+			Wait,
+			Call
+		};
+
+		struct step
+		{
+			kind kind_;
+			std::uint32_t first_;	// first record for Send, milliseconds for Wait, index into calls for Call
+			std::uint32_t count_;
+			std::uint8_t op_;		// of the action lowered into this step
+			bool action_;			// the first step of that action
+		};
+
+		plan()
+			: op_(ID::CairoElephant), begun_(false) {}
+
+		// lower an action, returns false if it cannot be...
+		bool lower(const injectable& a)
+		{
+			op_ = static_cast<std::uint8_t>(a.id());
+			begun_ = false;
+			return a.compile(*this);
+		}
+
+		// append records to be sent together...
+		void send(const INPUT* inputs, unsigned int count)
+		{
+			if (!count)
+				return;
+			push(Send, static_cast<std::uint32_t>(inputs_.size()), count);
+			inputs_.insert(inputs_.end(), inputs, inputs + count);
+		}
+
+		// records whose first is an absolute move to pixel x, y, so they can follow the screen if it changes...
+		void send(const INPUT* inputs, unsigned int count, int x, int y);
+
+		void wait(unsigned int millisecs)
+		{
+			push(Wait, millisecs, 0);
+		}
+
+		// an action which could not be lowered, injected as is...
+		void call(const action& a)
+		{
+			op_ = static_cast<std::uint8_t>(a->id());
+			begun_ = false;
+			push(Call, static_cast<std::uint32_t>(calls_.size()), 0);
+			calls_.push_back(a);
+		}
+
+		playStats play() const
+		{
+			return play(backend::current());
+		}
+
+		playStats play(backend& b) const
+		{
+			return play(b, playback());
+		}
+
+		playStats play(backend& b, const playback& options) const;
+
+		// lowers the actions of a replay as it walks them and sends them in bursts, so no plan is compiled ahead...
+		class batch;
+
+		const std::vector<step>& steps() const { return steps_; }
+		const std::vector<INPUT>& inputs() const { return inputs_; }
+
+		void clear()
+		{
+			inputs_.clear();
+			steps_.clear();
+			calls_.clear();
+			points_.clear();
+			begun_ = false;
+		}
+
+	private:
+		struct point
+		{
+			std::uint32_t input_;
+			int x_, y_;
+		};
+
+		void run(backend& b, timeline& clock, std::size_t burst) const;
+
+		void push(kind k, std::uint32_t first, std::uint32_t count)
+		{
+			step s = { k, first, count, op_, !begun_ };
+			steps_.push_back(s);
+			begun_ = true;
+		}
+
+		std::vector<INPUT> inputs_;
+		std::vector<step> steps_;
+		std::vector<action> calls_;
+		std::vector<point> points_;
+		int width_ = 0, height_ = 0;	// the screen the points were lowered for
+		std::uint8_t op_;				// the action being lowered
+		bool begun_;
+	};
+
+	namespace program
+	{
+		// a started program, as waits for it to be idle find it...
+		struct process
+		{
+#ifdef GHOST_WINDOWS
+			HANDLE handle_;
+#else
+			pid_t pid_;
+#endif
+
+			bool operator==(const process& other) const
+			{
+#ifdef GHOST_WINDOWS
+				return handle_ == other.handle_;
+#else
+				return pid_ == other.pid_;
+#endif
+			}
+
+			// the process on this thread, that of the session playing on it or otherwise the last exec run on it...
+			static process& current()
+			{
+				static thread_local process p = process();
+				return p;
+			}
+
+			class scope;
+		};
+
+		// make a process current on this thread for the lifetime of the scope...
+		class process::scope
+		{
+			process previous_;
+		public:
+			scope(const process& p)
+				: previous_(current())
+			{
+				current() = p;
+			}
+			~scope()
+			{
+				current() = previous_;
+			}
+
+		private:
+			scope(const scope&);
+			scope& operator=(const scope&);
+		};
+
+		class exec : public injectable
+		{
+			std::string program_;
+			std::string display_;
+#ifdef GHOST_WINDOWS
+			PROCESS_INFORMATION processInfo_;
+#else
+			pid_t pid_;
+#endif
+		public:
+			exec(const std::string& program)
+				: program_(program)
+			{
+#ifdef GHOST_WINDOWS
+				processInfo_ = PROCESS_INFORMATION();
+#else
+				pid_ = -1;
+#endif
+			}
+
+			std::string op() const { return ID::str[ID::Exec]; }
+			unsigned int id() const { return ID::Exec; }
+			std::string args() const { return program_; }
+
+			// the X display to run on, elsewhere this does nothing...
+			void display(const std::string& name) { display_ = name; }
+			const std::string& display() const { return display_; }
+
+			void run()
+			{
+				tracer::scope trace("exec", "program");
+				if (program_.empty())
+				{
+					// we do not invoke programs...
+				}
+				else
+				{
+#ifdef GHOST_WINDOWS
+					STARTUPINFO info = { sizeof(info) };
+					LPSTR s = const_cast<char *>(program_.c_str());
+					if (!CreateProcess(NULL, s, NULL, NULL, TRUE, 0, NULL, NULL, &info, &processInfo_))
+					{
+						logger::write<logger::Error>("unable to start program", *this);
+						throw std::runtime_error("Unable to start program...");
+					}
+#else
+					// through the shell, which the program replaces, with DISPLAY set if there is one...
+					std::vector<std::string> env;
+					for (char** e = environ; e && *e; ++e)
+						if (display_.empty() || std::string(*e).compare(0, 8, "DISPLAY=") != 0)
+							env.push_back(*e);
+					if (!display_.empty())
+						env.push_back("DISPLAY=" + display_);
+					std::vector<char*> envp;
+					for (std::vector<std::string>::iterator itr = env.begin(); itr != env.end(); ++itr)
+						envp.push_back(&(*itr)[0]);
+					envp.push_back(nullptr);
+
+					std::string shell("sh"), flag("-c"), command("exec " + program_);
+					char* argv[] = { &shell[0], &flag[0], &command[0], nullptr };
+					if (posix_spawn(&pid_, "/bin/sh", nullptr, nullptr, argv, &envp[0]))
+					{
+						pid_ = -1;
+						logger::write<logger::Error>("unable to start program", *this);
+						throw std::runtime_error("Unable to start program...");
+					}
+#endif
+					process::current() = started();
+				}
+				
+			}
+			void inject() const
+			{
+
+			}
+			bool compile(plan&) const { return true; }
+			bool encode(binary::record& r, std::string& text) const
+			{
+				r.op_ = ID::Exec;
+				r.a_ = static_cast<std::int32_t>(program_.size());
+				text = program_;
+				return true;
+			}
+#ifdef GHOST_WINDOWS
+			HANDLE handle() 
+			{
+				if (program_.empty())
+				{
+					return NULL;
+				}
+				else
+					return processInfo_.hProcess; 
+			}
+			DWORD threadID()
+			{
+				if (program_.empty())
+				{
+					return 0;
+				}
+				else
+					return processInfo_.dwThreadId;
+			}
+#else
+			pid_t pid() const { return pid_; }
+#endif
+
+			// the process running, if any...
+			process started() const
+			{
+				process p = process();
+#ifdef GHOST_WINDOWS
+				if (!program_.empty())
+					p.handle_ = processInfo_.hProcess;
+#else
+				p.pid_ = pid_ > 0 ? pid_ : 0;
+#endif
+				return p;
+			}
+
+			void wait()
+			{
+#ifdef GHOST_WINDOWS
+				if (program_.empty())
+				{
+
+				}
+				else if (processInfo_.hProcess != NULL)
+					WaitForSingleObject(processInfo_.hProcess, INFINITE);
+#else
+				if (pid_ > 0)
+				{
+					waitpid(pid_, nullptr, 0);
+					forget();
+					pid_ = -1;
+				}
+#endif
+			}
+
+			// started and not yet exited...
+			bool running()
+			{
+#ifdef GHOST_WINDOWS
+				return !program_.empty() && processInfo_.hProcess != NULL && WaitForSingleObject(processInfo_.hProcess, 0) == WAIT_TIMEOUT;
+#else
+				if (pid_ > 0 && waitpid(pid_, nullptr, WNOHANG) == pid_)
+					pid_ = -1;
+				return pid_ > 0;
+#endif
+			}
+
+			void terminate()
+			{
+#ifdef GHOST_WINDOWS
+				if (program_.empty())
+				{
+
+				}
+				else if (processInfo_.hProcess != NULL)
+				{
+					forget();
+					CloseHandle(processInfo_.hProcess);
+					CloseHandle(processInfo_.hThread);
+				}
+#else
+				// nothing else will reap it...
+				if (pid_ > 0)
+				{
+					kill(pid_, SIGTERM);
+					waitpid(pid_, nullptr, 0);
+					forget();
+					pid_ = -1;
+				}
+#endif
+			}
+
+		private:
+			// the process is gone, waits on this thread no longer look for it...
+			void forget() const
+			{
+				if (process::current() == started())
+					process::current() = process();
+			}
+		};
+
+		// actions
+		class wait : public injectable
+		{
+			unsigned int millisecs_;
+		public:
+			wait(const std::string& args) : millisecs_(0) { std::istringstream iss(args); iss >> millisecs_; }
+			wait(unsigned int millisecs) : millisecs_(millisecs) {}
+
+			std::string op() const { return ID::str[ID::Wait]; }
+			unsigned int id() const { return ID::Wait; }
+			std::string args() const { return std::to_string(millisecs_); }
+
+			void inject() const
+			{
+				if (timeline* t = timeline::current())
+					t->wait(millisecs_);
+				else
+				{
+					tracer::scope trace("wait", "wait", "ms", millisecs_);
+					pacer::local().until(timeline::clock::now() + std::chrono::milliseconds(millisecs_));
+				}
+			}
+			bool compile(plan& p) const
+			{
+				p.wait(millisecs_);
+				return true;
+			}
+			bool encode(binary::record& r, std::string&) const
+			{
+				r.op_ = ID::Wait;
+				r.a_ = static_cast<std::int32_t>(millisecs_);
+				return true;
+			}
+		};
+
+		// waits for the target to be ready rather than for a fixed time, failing after a timeout in milliseconds. The
+		// condition is checked at intervals doubling from one millisecond up to a hundred, and a replay carries on
+		// from when it held...
+		class condition : public injectable
+		{
+		protected:
+			unsigned int timeout_;
+
+			condition(unsigned int timeout)
+				: timeout_(timeout) {}
+
+			// check ready until it holds, text is that of the action if it has any...
+			template<typename F>
+			static void poll(unsigned int id, const char* text, unsigned int timeout, F ready)
+			{
+				typedef timeline::clock clock;
+				tracer::scope trace(ID::str[id].c_str(), "wait", "ms", timeout);
+				clock::time_point deadline = clock::now() + std::chrono::milliseconds(timeout);
+				clock::duration interval = std::chrono::milliseconds(1);
+				while (!ready())
+				{
+					clock::time_point now = clock::now();
+					if (now >= deadline)
+					{
+						binary::record r = logger::nothing();
+						r.op_ = static_cast<std::uint8_t>(id);
+						r.a_ = static_cast<std::int32_t>(text ? std::strlen(text) : ID::text(id) ? 0 : timeout);
+						r.b_ = static_cast<std::int32_t>(timeout);
+						logger::write<logger::Error>("timed out waiting", r);
+						throw std::runtime_error("Timed out waiting for " + ID::str[id] + " {" + std::to_string(timeout) + (text ? std::string(",") + text : std::string()) + "}");
+					}
+					std::this_thread::sleep_for((std::min)(interval, deadline - now));
+					interval = (std::min)(interval * 2, clock::duration(std::chrono::milliseconds(100)));
+				}
+
+				if (timeline* t = timeline::current())
+					t->synced();
+			}
+
+			// the record for an action with some text...
+			bool describe(binary::record& r, std::string& text, const std::string& str) const
+			{
+				r.op_ = static_cast<std::uint8_t>(id());
+				r.a_ = static_cast<std::int32_t>(str.size());
+				r.b_ = static_cast<std::int32_t>(timeout_);
+				text = str;
+				return true;
+			}
+
+		public:
+			unsigned int timeout() const { return timeout_; }
+		};
+
+		// until the program started last, or that of the session playing, is waiting for input. On Windows this is
+		// as WaitForInputIdle says. Elsewhere the program is idle once it has been seen sleeping without using the
+		// processor for five clock ticks, which is as near as can be told from outside. Processor time is counted in
+		// ticks, so a program busy for less than one between two checks would look idle on those alone. There being
+		// no program to wait for is the same as it being idle...
+		class idle : public condition
+		{
+		public:
+			idle(unsigned int timeout) : condition(timeout) {}
+
+			std::string op() const { return ID::str[ID::Idle]; }
+			unsigned int id() const { return ID::Idle; }
+			std::string args() const { return std::to_string(timeout_); }
+
+			void inject() const
+			{
+				inject(timeout_);
+			}
+
+			bool compile(plan& p) const
+			{
+				p.call(std::make_shared<idle>(*this));
+				return true;
+			}
+			bool encode(binary::record& r, std::string&) const
+			{
+				r.op_ = ID::Idle;
+				r.a_ = static_cast<std::int32_t>(timeout_);
+				return true;
+			}
+
+			static void inject(unsigned int timeout)
+			{
+				process p = process::current();
+				quiet q = { ~std::uint64_t(0), timeline::clock::time_point() };
+				poll(ID::Idle, nullptr, timeout, [&p, &q]() { return ready(p, q); });
+			}
+
+		private:
+			// the processor time at the last check and since when it has not changed...
+			struct quiet
+			{
+				std::uint64_t used_;
+				timeline::clock::time_point since_;
+			};
+
+			static bool ready(const process& p, quiet& q)
+			{
+#ifdef GHOST_WINDOWS
+				// console programs and those which have exited fail, there is nothing to wait for...
+				return !p.handle_ || WaitForInputIdle(p.handle_, 0) != WAIT_TIMEOUT;
+#else
+				if (p.pid_ <= 0)
+					return true;
+				char path[32];
+				std::snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(p.pid_));
+				std::FILE* file = std::fopen(path, "r");
+				if (!file)
+					return true;
+				char stat[512];
+				std::size_t size = std::fread(stat, 1, sizeof(stat) - 1, file);
+				std::fclose(file);
+				stat[size] = '\0';
+
+				// the name in brackets may hold anything, the state and numbers follow the last bracket...
+				const char* fields = std::strrchr(stat, ')');
+				char state = 0;
+				unsigned long long user = 0, system = 0;
+				if (!fields || std::sscanf(fields + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &state, &user, &system) != 3)
+					return true;
+
+				timeline::clock::time_point now = timeline::clock::now();
+				if (state != 'S' || user + system != q.used_)
+				{
+					q.used_ = user + system;
+					q.since_ = now;
+				}
+				return state == 'Z' || (state == 'S' && now - q.since_ >= settle());
+#endif
+			}
+
+#ifndef GHOST_WINDOWS
+			// five clock ticks...
+			static timeline::clock::duration settle()
+			{
+				static const timeline::clock::duration d = std::chrono::milliseconds(5000 / (std::max)(sysconf(_SC_CLK_TCK), 1L));
+				return d;
+			}
+#endif
+		};
+
+		// until a top level window with a title is open, as the backend sees it...
+		class window : public condition
+		{
+			std::string title_;
+			bool focused_;
+
+		protected:
+			window(const std::string& title, unsigned int timeout, bool focused)
+				: condition(timeout), title_(title), focused_(focused) {}
+
+		public:
+			window(const std::string& title, unsigned int timeout)
+				: condition(timeout), title_(title), focused_(false) {}
+
+			std::string op() const { return ID::str[id()]; }
+			unsigned int id() const { return focused_ ? ID::Focus : ID::Window; }
+			std::string args() const { return std::to_string(timeout_) + "," + title_; }
+
+			const std::string& title() const { return title_; }
+
+			void inject() const
+			{
+				inject(title_.c_str(), timeout_, focused_);
+			}
+
+			bool compile(plan& p) const
+			{
+				p.call(std::make_shared<window>(*this));
+				return true;
+			}
+			bool encode(binary::record& r, std::string& text) const { return describe(r, text, title_); }
+
+			// wait on a window without holding on to its title...
+			static void inject(const char* title, unsigned int timeout, bool focused)
+			{
+				poll(focused ? ID::Focus : ID::Window, title, timeout, [title, focused]() { return backend::current().window(title, focused); });
+			}
+		};
+
+		// until a window with a title has the focus...
+		class focus : public window
+		{
+		public:
+			focus(const std::string& title, unsigned int timeout)
+				: window(title, timeout, true) {}
+		};
+
+		// until a predicate holds. Predicates are defined by name so scripts can refer to them, one given directly
+		// has no name and so no script syntax it can be read back from...
+		class until : public condition
+		{
+			std::string name_;
+			std::function<bool()> predicate_;
+
+		public:
+			until(const std::string& name, unsigned int timeout)
+				: condition(timeout), name_(name) {}
+			until(std::function<bool()> predicate, unsigned int timeout)
+				: condition(timeout), predicate_(predicate) {}
+
+			std::string op() const { return ID::str[ID::Until]; }
+			unsigned int id() const { return ID::Until; }
+			std::string args() const { return std::to_string(timeout_) + "," + name_; }
+
+			const std::string& name() const { return name_; }
+
+			void inject() const
+			{
+				if (predicate_)
+					poll(ID::Until, nullptr, timeout_, predicate_);
+				else
+					inject(name_.c_str(), timeout_);
+			}
+
+			bool compile(plan& p) const
+			{
+				p.call(std::make_shared<until>(*this));
+				return true;
+			}
+			bool encode(binary::record& r, std::string& text) const { return !predicate_ && describe(r, text, name_); }
+
+			// name a predicate, replacing any of the same name...
+			static void define(const std::string& name, std::function<bool()> predicate)
+			{
+				std::lock_guard<std::mutex> lock(predicates().mutex_);
+				forget(name, lock);
+				predicates().defined_.push_back(std::make_pair(name, predicate));
+			}
+
+			static void forget(const std::string& name)
+			{
+				std::lock_guard<std::mutex> lock(predicates().mutex_);
+				forget(name, lock);
+			}
+
+			// wait on a predicate by name...
+			static void inject(const char* name, unsigned int timeout)
+			{
+				std::function<bool()> predicate;
+				{
+					std::lock_guard<std::mutex> lock(predicates().mutex_);
+					for (auto itr = predicates().defined_.begin(); itr != predicates().defined_.end(); ++itr)
+						if (itr->first == name)
+							predicate = itr->second;
+				}
+				if (!predicate)
+					throw std::runtime_error(std::string("Unknown predicate ") + name);
+				poll(ID::Until, name, timeout, predicate);
+			}
+
+		private:
+			struct registry
+			{
+				std::mutex mutex_;
+				std::vector<std::pair<std::string, std::function<bool()> > > defined_;
+			};
+
+			static registry& predicates()
+			{
+				static registry r;
+				return r;
+			}
+
+			static void forget(const std::string& name, std::lock_guard<std::mutex>&)
+			{
+				std::vector<std::pair<std::string, std::function<bool()> > >& defined = predicates().defined_;
+				for (auto itr = defined.begin(); itr != defined.end(); ++itr)
+					if (itr->first == name)
+					{
+						defined.erase(itr);
+						return;
+					}
+			}
+		};
+
+	}
+	
+
+	// mouse actions
+	namespace mouse
+	{
+		enum button
+		{
+			None = 0,
+			Left,
+			Right,
+			Middle,
+			X,
+			CairoElephant
+		};
+
+		static const std::vector<std::string> buttonStr({
+			"m",
+			"ml",
+			"mr",
+			"mm",
+			"mx",
+			"ce"
+			});
+
+		struct screen
+		{
+			screen()
+			{
+#ifdef GHOST_WINDOWS
+				RECT desktop;
+				// Get a handle to the desktop window
+				const HWND hDesktop = GetDesktopWindow();
+				// Get the size of screen to the variable desktop
+				GetWindowRect(hDesktop, &desktop);
+
+				left_ = desktop.left;
+				right_ = desktop.right;
+				top_ = desktop.top;
+				bottom_ = desktop.bottom;
+#else
+				const backend& b = backend::current();
+				left_ = 0;
+				right_ = b.width();
+				top_ = 0;
+				bottom_ = b.height();
+#endif
+				scale();
+			}
+			screen(const backend& b)
+				: left_(0), right_(b.width()), top_(0), bottom_(b.height())
+			{
+				scale();
+			}
+
+			int width() const { return abs(right_ - left_); }
+			int height() const { return abs(top_ - bottom_); }
+
+			// absolute input coordinates (0 - 65535 across the screen) aimed at the centre of a pixel. Fixed point so
+			// there is no division per event and no drift across the screen on sizes which do not divide 65536...
+			LONG absoluteX(int x) const { return static_cast<LONG>(((2 * static_cast<std::int64_t>(x) + 1) * scaleX_) >> 25); }
+			LONG absoluteY(int y) const { return static_cast<LONG>(((2 * static_cast<std::int64_t>(y) + 1) * scaleY_) >> 25); }
+
+			// the pixel an absolute coordinate lands on across size pixels, rounded down as SendInput does...
+			static int pixel(LONG absolute, int size) { return static_cast<int>((static_cast<std::int64_t>(absolute) * size) >> 16); }
+
+			// the screen of a backend, cached per thread until the display changes...
+			static const screen& current(const backend& b)
+			{
+				struct cache
+				{
+					const backend* backend_;
+					unsigned int revision_;
+					screen screen_;
+				};
+				static thread_local cache c = { nullptr, 0, screen(0, 0) };
+
+				unsigned int revision = backend::revision();
+				if (c.backend_ != &b || c.revision_ != revision)
+				{
+					c.screen_ = screen(b);
+					c.backend_ = &b;
+					c.revision_ = revision;
+				}
+				return c.screen_;
+			}
+			static const screen& current()
+			{
+				return current(backend::current());
+			}
+
+			int left_, right_, top_, bottom_;
+
+			// 2^40 / size, so (2x + 1) * scale >> 25 is (x + 0.5) * 65536 / size...
+			std::int64_t scaleX_, scaleY_;
+
+		private:
+			screen(int width, int height)
+				: left_(0), right_(width), top_(0), bottom_(height)
+			{
+				scale();
+			}
+
+			void scale()
+			{
+				scaleX_ = width() ? (static_cast<std::int64_t>(1) << 40) / width() : 0;
+				scaleY_ = height() ? (static_cast<std::int64_t>(1) << 40) / height() : 0;
+			}
+		};
+
+		class base : public injectable
+		{
+		public:
+			base()
+				: button_(button::None) {}
+			base(const button& button)
+				: button_(button) {}
+			base(const button& button, int x, int y)
+				: button_(button), x_(x), y_(y) 
+			{
+				int g = 0;
+				++g;
+			}
+
+			std::string args() const
+			{
+				std::ostringstream oss;
+				oss << buttonStr[static_cast<unsigned int>(button_)] << " " << x_ << " " << y_;
+				return oss.str();
+			}
+
+			void inject() const
+			{
+				INPUT input[2] = {};
+				backend& b = backend::current();
+				b.send(input, lower(input, b));
+			}
+
+			bool compile(plan& p) const
+			{
+				INPUT input[2] = {};
+				p.send(input, lower(input, backend::current()), x_, y_);
+				return true;
+			}
+
+		protected:
+			// a record of this action with its button and position...
+			bool describe(binary::record& r, ID::id id) const
+			{
+				r.op_ = static_cast<std::uint8_t>(id);
+				r.arg_ = static_cast<std::uint8_t>(button_);
+				r.a_ = x_;
+				r.b_ = y_;
+				return true;
+			}
+
+			// fill in the records for this action, returns how many...
+			virtual unsigned int lower(INPUT* input, const backend& b) const = 0;
+
+			// absolute move to this actions position...
+			void position(INPUT& input, const backend& b) const
+			{
+				const screen& scn = screen::current(b);
+				input.type = INPUT_MOUSE;
+				input.mi.dx = scn.absoluteX(x_);
+				input.mi.dy = scn.absoluteY(y_);
+				input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+			}
+
+			void setButton(const std::string& bStr)
+			{
+				for (unsigned int id = button::None; id <= button::CairoElephant; ++id)
+					if (buttonStr[id] == bStr)
+					{
+						button_ = static_cast<button>(id);
+						return;
+					}
+			}
+
+			button button_;
+			int x_, y_;
+		};
+
+
+		class down : public base
+		{
+		public:
+			down(const button& button, int x, int y)
+				: base(button, x, y) {}
+			down(const std::string& args)
+			{
+				std::string bArgs;
+				std::istringstream iss(args);
+				iss >> bArgs >> std::ws >> x_ >> std::ws >> y_;
+				setButton(bArgs);
+			}
+
+			std::string op() const { return ID::str[ID::MouseDown]; }
+			unsigned int id() const { return ID::MouseDown; }
+			bool encode(binary::record& r, std::string&) const { return describe(r, ID::MouseDown); }
+
+		protected:
+			unsigned int lower(INPUT* input, const backend& b) const
+			{
+				position(input[0], b);
+
+				input[1].type = INPUT_MOUSE;
+				switch (button_)
+				{
+				case button::Right:
+					input[1].mi.dwFlags = MOUSEEVENTF_RIGHTDOWN;
+					break;
+				case button::Left:
+					input[1].mi.dwFlags = MOUSEEVENTF_LEFTDOWN;
+					break;
+				case button::Middle:
+					input[1].mi.dwFlags = MOUSEEVENTF_MIDDLEDOWN;
+					break;
+				case button::X:
+					input[1].mi.dwFlags = MOUSEEVENTF_XDOWN;
+					break;
+				default:
+					break;
+				}
+
+				return 2;
+			}
+		};
+
+		class up : public base
+		{
+		public:
+			up(const button& button, int x, int y)
+				: base(button, x, y) {}
+			up(const std::string& args)
+			{
+				std::string bArgs;
+				std::istringstream iss(args);
+				iss >> bArgs >> std::ws >> x_ >> std::ws >> y_;
+				setButton(bArgs);
+			}
+
+			std::string op() const { return ID::str[ID::MouseUp]; }
+			unsigned int id() const { return ID::MouseUp; }
+			bool encode(binary::record& r, std::string&) const { return describe(r, ID::MouseUp); }
+
+		protected:
+			unsigned int lower(INPUT* input, const backend& b) const
+			{
+				position(input[0], b);
+
+				input[1].type = INPUT_MOUSE;
+				switch (button_)
+				{
+				case button::Right:
+					input[1].mi.dwFlags = MOUSEEVENTF_RIGHTUP;
+					break;
+				case button::Left:
+					input[1].mi.dwFlags = MOUSEEVENTF_LEFTUP;
+					break;
+				case button::Middle:
+					input[1].mi.dwFlags = MOUSEEVENTF_MIDDLEUP;
+					break;
+				case button::X:
+					input[1].mi.dwFlags = MOUSEEVENTF_XUP;
+					break;
+				default:
+					break;
+				}
+
+				return 2;
+			}
+		};
+
+		class wheel : public base
+		{
+			int value_;
+		public:
+			wheel(int value, int x, int y)
+				: base(button::None, x, y), value_(value) {}
+			wheel(const std::string& args)
+			{
+				std::istringstream iss(args);
+				iss >> value_ >> std::ws >> x_ >> std::ws >> y_;
+			}
+
+			std::string op() const { return ID::str[ID::MouseWheel]; }
+			unsigned int id() const { return ID::MouseWheel; }
+			std::string args() const
+			{
+				std::ostringstream oss;
+				oss << value_ << " " << x_ << " " << y_;
+				return oss.str();
+			}
+			bool encode(binary::record& r, std::string&) const
+			{
+				describe(r, ID::MouseWheel);
+				r.a_ = value_;
+				r.b_ = x_;
+				r.c_ = y_;
+				return true;
+			}
+
+		protected:
+			unsigned int lower(INPUT* input, const backend& b) const
+			{
+				position(input[0], b);
+
+				input[1].type = INPUT_MOUSE;
+				input[1].mi.dwFlags = MOUSEEVENTF_WHEEL;
+				input[1].mi.mouseData = value_;
+
+				return 2;
+			}
+		};
+
+		class move : public base
+		{
+		public:
+			move(int x, int y)
+				: base(button::None, x, y) {}
+			move(const std::string& args)
+			{
+				std::istringstream iss(args);
+				iss >> x_ >> std::ws >> y_;
+			}
+
+			std::string op() const { return ID::str[ID::MouseMove]; }
+			unsigned int id() const { return ID::MouseMove; }
+			std::string args() const
+			{
+				std::ostringstream oss;
+				oss << x_ << " " << y_;
+				return oss.str();
+			}
+			bool encode(binary::record& r, std::string&) const { return describe(r, ID::MouseMove); }
+
+		protected:
+			unsigned int lower(INPUT* input, const backend& b) const
+			{
+				position(input[0], b);
+				return 1;
+			}
+		};
+
+	}	// namespace mouse
+
+
+	inline playStats plan::play(backend& b, const playback& options) const
+	{
+		playStats stats;
+		backend::scope scope(b);
+		timeline clock(options, stats);
+		run(b, clock, options.burst_);
+		return stats;
+	}
+
+	inline void plan::run(backend& b, timeline& clock, std::size_t burst) const
+	{
+		// lowered for another screen, rescale a copy...
+		std::vector<INPUT> rescaled;
+		const INPUT* inputs = inputs_.empty() ? nullptr : &inputs_.front();
+		const mouse::screen& scn = mouse::screen::current(b);
+		if (!points_.empty() && (scn.width() != width_ || scn.height() != height_))
+		{
+			rescaled = inputs_;
+			for (std::vector<point>::const_iterator itr = points_.begin(); itr != points_.end(); ++itr)
+			{
+				rescaled[itr->input_].mi.dx = scn.absoluteX(itr->x_);
+				rescaled[itr->input_].mi.dy = scn.absoluteY(itr->y_);
+			}
+			inputs = &rescaled.front();
+		}
+
+		for (std::vector<step>::const_iterator itr = steps_.begin(); itr != steps_.end(); ++itr)
+		{
+			switch (itr->kind_)
+			{
+			case Send:
+				if (burst)
+				{
+					// the records of adjacent sends are adjacent too, so a burst is just a longer send...
+					// and is timed as one, for the op which starts it...
+					std::vector<step>::const_iterator first = itr;
+					std::uint32_t count = itr->count_;
+					while (itr + 1 != steps_.end() && (itr + 1)->kind_ == Send && count + (itr + 1)->count_ <= burst)
+						count += (++itr)->count_;
+					const INPUT* records = inputs + itr->first_ + itr->count_ - count;
+					clock.measure(first->op_, first->action_, [&b, records, count]() { b.send(records, count); });
+					for (++first; first <= itr; ++first)
+						if (first->action_)
+							clock.begun(first->op_);
+				}
+				else
+					clock.measure(itr->op_, itr->action_, [&b, inputs, itr]() { b.send(inputs + itr->first_, itr->count_); });
+				break;
+			case Wait:
+				if (itr->action_)
+					clock.begun(itr->op_);
+				clock.wait(itr->first_);
+				break;
+			case Call:
+				clock.measure(itr->op_, itr->action_, [this, itr]() { calls_[itr->first_]->inject(); });
+				break;
+			}
+		}
+	}
+
+	inline void plan::send(const INPUT* inputs, unsigned int count, int x, int y)
+	{
+		if (!count)
+			return;
+		if (points_.empty())
+		{
+			const mouse::screen& scn = mouse::screen::current();
+			width_ = scn.width();
+			height_ = scn.height();
+		}
+		point pt = { static_cast<std::uint32_t>(inputs_.size()), x, y };
+		points_.push_back(pt);
+		send(inputs, count);
+	}
+
+	// bursts for replays which cannot keep a plan of everything, mapped images and files played as they are read.
+	// Sends are held in the plan given until a wait, an action which cannot be lowered or enough records for some
+	// bursts, then everything held is played. A burst may be cut short where the held records end. Without a burst
+	// each action is injected as it comes...
+	class plan::batch
+	{
+	public:
+		batch(backend& b, timeline& clock, std::size_t burst, plan& held)
+			: backend_(b), clock_(clock), burst_(burst), held_(held)
+		{
+			held_.clear();
+		}
+
+		template<typename A>
+		void operator()(const A& a)
+		{
+			if (!burst_)
+				return clock_.inject(a);
+
+			std::size_t before = held_.steps().size();
+			if (!held_.lower(a))
+			{
+				flush();
+				return clock_.inject(a);
+			}
+			if (held_.inputs().size() >= burst_ && held_.inputs().size() >= held)
+				return flush();
+			for (std::size_t i = before; i < held_.steps().size(); ++i)
+				if (held_.steps()[i].kind_ != Send)
+					return flush();
+		}
+
+		// play what is held, once the last action has been given...
+		void flush()
+		{
+			if (held_.steps().empty())
+				return;
+			held_.run(backend_, clock_, burst_);
+			held_.clear();
+		}
+
+	private:
+		// records held before they are played...
+		static const std::size_t held = 4096;
+
+		backend& backend_;
+		timeline& clock_;
+		std::size_t burst_;
+		plan& held_;
+	};
+
+	namespace keyboard
+	{
+		// these are the special keys
+		enum key
+		{
+			None = 0,
+			Enter,
+			Cancel,
+			Backspace,
+			Tab,
+			Shift,
+			Control,
+			Alt,
+			Pause,
+			Capslock,
+			Escape,
+			Space,
+			PageUp,
+			PageDown,
+			End,
+			Home,
+			Left,
+			Right,
+			Up,
+			Down,
+			Select,
+			Print,
+			Insert,
+			Delete,
+			Help,
+			
+
+			CairoElephant
+
+		};
+
+		struct keyCode
+		{
+			keyCode(const std::string& str, unsigned char key)
+				: str_(str), key_(key)
+			{
+			}
+
+			std::string str_;
+			unsigned char key_;
+		};
+
+		static const std::vector<keyCode> special({
+			keyCode("", 0),
+			keyCode("Enter", VK_RETURN),
+			
+			keyCode("CairoElephant", 0)
+			});
+
+		class base : public injectable
+		{
+		public:
+			base(unsigned char k)
+				: key_(k) {}
+			base(const key& k)
+				: key_(special[k].key_) {}
+
+			std::string args() const
+			{
+				return std::to_string(key_);
+			}
+
+		protected:
+			// the hardware scan code for a key...
+			static unsigned short scanCode(unsigned char k)
+			{
+#ifdef GHOST_WINDOWS
+				BYTE vk = LOBYTE(VkKeyScan(static_cast<char>(k)));
+				return static_cast<unsigned short>(MapVirtualKey(vk, 0) & 0xff);
+#else
+				// no keyboard layout to consult, backends receive the key itself...
+				return k;
+#endif
+			}
+
+			// the record for a key going down or up...
+			static void lower(INPUT& input, unsigned char k, bool up)
+			{
+				input.type = INPUT_KEYBOARD;
+				input.ki.wScan = scanCode(k);
+				input.ki.dwFlags = up ? KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP : KEYEVENTF_SCANCODE;
+			}
+
+			// a press lowered into a plan...
+			static void compilePress(plan& p, unsigned char k)
+			{
+				INPUT input[2] = {};
+				lower(input[0], k, false);
+				lower(input[1], k, true);
+				p.send(&input[0], 1);
+				p.wait(10);
+				p.send(&input[1], 1);
+			}
+
+			// keys are written as their code...
+			unsigned char getKey(const std::string& keySyntax)
+			{
+				unsigned int result = 0;
+				std::istringstream iss(keySyntax); iss >> result;
+				return static_cast<unsigned char>(result);
+			}
+
+			bool describe(binary::record& r, ID::id id) const
+			{
+				r.op_ = static_cast<std::uint8_t>(id);
+				r.arg_ = key_;
+				return true;
+			}
+			unsigned char key_;
+		};
+
+
+		class down : public base
+		{
+		public:
+			down(unsigned char k) : base(k) {}
+			down(const key& k) : base(k) {}
+			down(const std::string& args)
+				: base(getKey(args))
+			{
+			}
+
+			std::string op() const { return ID::str[ID::KeyDown]; }
+			unsigned int id() const { return ID::KeyDown; }
+			bool encode(binary::record& r, std::string&) const { return describe(r, ID::KeyDown); }
+
+			void inject() const
+			{
+				INPUT input = {};
+				lower(input, key_, false);
+				backend::current().send(&input, 1);
+			}
+
+			bool compile(plan& p) const
+			{
+				INPUT input = {};
+				lower(input, key_, false);
+				p.send(&input, 1);
+				return true;
+			}
+		};
+
+		class up : public base
+		{
+		public:
+			up(unsigned char k) : base(k) {}
+			up(const key& k) : base(k) {}
+			up(const std::string& args)
+				: base(getKey(args))
+			{
+			}
+
+			std::string op() const { return ID::str[ID::KeyUp]; }
+			unsigned int id() const { return ID::KeyUp; }
+			bool encode(binary::record& r, std::string&) const { return describe(r, ID::KeyUp); }
+
+			void inject() const
+			{
+				INPUT input = {};
+				lower(input, key_, true);
+				backend::current().send(&input, 1);
+			}
+
+			bool compile(plan& p) const
+			{
+				INPUT input = {};
+				lower(input, key_, true);
+				p.send(&input, 1);
+				return true;
+			}
+		};
+
+		class press : public base
+		{
+		public:
+			press(unsigned char k) : base(k) {}
+			press(const key& k) : base(k) {}
+			press(const std::string& args)
+				: base(getKey(args))
+			{
+			}
+			std::string op() const { return ID::str[ID::KeyPress]; }
+			unsigned int id() const { return ID::KeyPress; }
+			bool encode(binary::record& r, std::string&) const { return describe(r, ID::KeyPress); }
+
+			void inject() const
+			{
+				keyboard::down(key_).inject();
+				program::wait(10).inject();
+				keyboard::up(key_).inject();
+			}
+
+			bool compile(plan& p) const
+			{
+				compilePress(p, key_);
+				return true;
+			}
+
+		};
+
+		class type : public base
+		{
+			std::string str_;
+		public:
+			type(const std::string& str) : base(key::None), str_(str) {}
+			
+			std::string op() const { return ID::str[ID::KeyType]; }
+			unsigned int id() const { return ID::KeyType; }
+			std::string args() const { return str_; }
+			bool encode(binary::record& r, std::string& text) const
+			{
+				describe(r, ID::KeyType);
+				r.a_ = static_cast<std::int32_t>(str_.size());
+				text = str_;
+				return true;
+			}
+
+			void inject() const
+			{
+				std::for_each(str_.begin(), str_.end(), [](char c) 
+				{
+					keyboard::press(c).inject();
+				});
+			}
+
+			bool compile(plan& p) const
+			{
+				for (std::string::const_iterator itr = str_.begin(); itr != str_.end(); ++itr)
+					compilePress(p, static_cast<unsigned char>(*itr));
+				return true;
+			}
+
+		};
+
+		// utf-8 text typed as unicode characters rather than keys, so it comes out the same whatever the keyboard
+		// layout. Characters are sent many to a submission, rate a second, or as fast as the target takes them
+		// when rate is zero...
+		class text : public base
+		{
+			std::string str_;
+			unsigned int rate_;
+		public:
+			text(const std::string& str, unsigned int rate = 0) : base(key::None), str_(str), rate_(rate) {}
+
+			std::string op() const { return ID::str[ID::KeyText]; }
+			unsigned int id() const { return ID::KeyText; }
+			std::string args() const { return std::to_string(rate_) + "," + str_; }
+			bool encode(binary::record& r, std::string& text) const
+			{
+				describe(r, ID::KeyText);
+				r.a_ = static_cast<std::int32_t>(str_.size());
+				r.b_ = static_cast<std::int32_t>(rate_);
+				text = str_;
+				return true;
+			}
+
+			unsigned int rate() const { return rate_; }
+
+			void inject() const
+			{
+				inject(str_.data(), str_.data() + str_.size(), rate_);
+			}
+
+			bool compile(plan& p) const
+			{
+				schedule(str_.data(), str_.data() + str_.size(), rate_,
+					[&p](const INPUT* inputs, unsigned int count) { p.send(inputs, count); },
+					[&p](unsigned int millisecs) { p.wait(millisecs); });
+				return true;
+			}
+
+			// type some text without holding on to it...
+			static void inject(const char* begin, const char* end, unsigned int rate)
+			{
+				backend& b = backend::current();
+				schedule(begin, end, rate,
+					[&b](const INPUT* inputs, unsigned int count)
+					{
+						// a submission may be taken in part...
+						while (count)
+						{
+							unsigned int sent = b.send(inputs, count);
+							if (!sent)
+							{
+								logger::write<logger::Error>("text input was blocked");
+								throw std::runtime_error("Text input was blocked.");
+							}
+							inputs += sent;
+							count -= sent;
+						}
+					},
+					[](unsigned int millisecs) { program::wait(millisecs).inject(); });
+			}
+
+		private:
+			// records for a submission, flushed before a character could overflow it...
+			static const unsigned int batch = 512;
+
+			// send the characters due at each step of the rate and wait in between...
+			template<typename Send, typename Wait>
+			static void schedule(const char* itr, const char* end, unsigned int rate, Send send, Wait wait)
+			{
+				INPUT inputs[batch];
+				unsigned int count = 0;
+				unsigned int interval = rate ? (std::max)(10u, (1000 + rate - 1) / rate) : 0;
+				std::uint64_t typed = 0, elapsed = 0;
+				while (itr != end)
+				{
+					std::uint64_t due = rate ? elapsed * rate / 1000 + 1 : ~std::uint64_t(0);
+					for (; itr != end && typed < due; ++typed)
+					{
+						count += lower(itr, end, inputs + count);
+						if (count + 4 > batch)
+						{
+							send(inputs, count);
+							count = 0;
+						}
+					}
+					if (count)
+					{
+						send(inputs, count);
+						count = 0;
+					}
+
+					if (itr != end)
+					{
+						wait(interval);
+						elapsed += interval;
+					}
+				}
+			}
+
+			// the records for the next character, a down and up for each utf-16 unit. Anything which is not
+			// utf-8 comes out as the replacement character...
+			static unsigned int lower(const char*& itr, const char* end, INPUT* inputs)
+			{
+				static const std::uint32_t least[] = { 0, 0, 0x80, 0x800, 0x10000 };
+
+				unsigned char c = static_cast<unsigned char>(*itr++);
+				std::uint32_t code = 0xfffd;
+				unsigned int length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 0;
+				if (length == 1)
+					code = c;
+				else if (length && end - itr >= static_cast<std::ptrdiff_t>(length - 1))
+				{
+					std::uint32_t value = c & (0x7f >> length);
+					unsigned int i = 1;
+					for (; i < length && (static_cast<unsigned char>(*itr) & 0xc0) == 0x80; ++i, ++itr)
+						value = (value << 6) | (static_cast<unsigned char>(*itr) & 0x3f);
+					if (i == length && value >= least[length] && value <= 0x10ffff && (value < 0xd800 || value > 0xdfff))
+						code = value;
+				}
+
+				if (code < 0x10000)
+					return unit(inputs, static_cast<WORD>(code));
+
+				code -= 0x10000;
+				unsigned int count = unit(inputs, static_cast<WORD>(0xd800 + (code >> 10)));
+				return count + unit(inputs + count, static_cast<WORD>(0xdc00 + (code & 0x3ff)));
+			}
+
+			static unsigned int unit(INPUT* inputs, WORD u)
+			{
+				for (unsigned int i = 0; i < 2; ++i)
+				{
+					inputs[i] = INPUT();
+					inputs[i].type = INPUT_KEYBOARD;
+					inputs[i].ki.wScan = u;
+					inputs[i].ki.dwFlags = i ? KEYEVENTF_UNICODE | KEYEVENTF_KEYUP : KEYEVENTF_UNICODE;
+				}
+				return 2;
+			}
+		};
+
+	}	// keyboard
+
+	// scripts written in code and fixed at compile time. A step is a literal record and a script is an array of
+	// them, checked as it is built: keys must have a code, waits cannot be negative and the first step must be an
+	// exec, so a bad script declared constexpr does not compile. Playing switches on each step and injects it as
+	// the action it stands for, there is nothing to allocate and the actions are not reached through injectable.
+	// Mice still lower their input and everything is sent through the backend, both virtual as in any replay.
+	// Playing with a burst lowers the steps into a plan as it goes, as images do...
+	//
+	//	constexpr auto macro = ghost::fixed::script(ghost::fixed::exec("cmd"), ghost::fixed::press('e'));
+	namespace fixed
+	{
+		struct step
+		{
+			std::uint8_t op_;
+			std::uint8_t arg_;			// mouse button or key
+			std::int32_t a_, b_, c_;
+			const char* text_;			// exec programs and typed strings
+		};
+
+		namespace impl
+		{
+			constexpr step make(ID::id op, std::uint8_t arg = 0, std::int32_t a = 0, std::int32_t b = 0, std::int32_t c = 0, const char* text = nullptr)
+			{
+				return step{ static_cast<std::uint8_t>(op), arg, a, b, c, text };
+			}
+
+			// printable characters and enter...
+			constexpr std::uint8_t key(char k)
+			{
+				return (k >= 0x20 && k < 0x7f) || k == VK_RETURN ? static_cast<std::uint8_t>(k) : throw std::logic_error("Unknown key");
+			}
+
+			// special keys with a code...
+			constexpr std::uint8_t key(keyboard::key k)
+			{
+				return k == keyboard::Enter ? static_cast<std::uint8_t>(VK_RETURN) : throw std::logic_error("Unknown key");
+			}
+
+			constexpr const char* text(const char* t)
+			{
+				for (const char* c = t; *c; ++c)
+					key(*c);
+				return t;
+			}
+
+			constexpr std::int32_t millisecs(long long m)
+			{
+				return m >= 0 && m <= 0x7fffffff ? static_cast<std::int32_t>(m) : throw std::logic_error("Waits cannot be negative");
+			}
+
+			constexpr std::int32_t rate(long long r)
+			{
+				return r >= 0 && r <= 0x7fffffff ? static_cast<std::int32_t>(r) : throw std::logic_error("Rates cannot be negative");
+			}
+		}
+
+		constexpr step exec(const char* program) { return impl::make(ID::Exec, 0, 0, 0, 0, program); }
+		constexpr step wait(long long millisecs) { return impl::make(ID::Wait, 0, impl::millisecs(millisecs)); }
+
+		constexpr step down(mouse::button b, int x, int y) { return impl::make(ID::MouseDown, static_cast<std::uint8_t>(b), x, y); }
+		constexpr step up(mouse::button b, int x, int y) { return impl::make(ID::MouseUp, static_cast<std::uint8_t>(b), x, y); }
+		constexpr step wheel(int value, int x, int y) { return impl::make(ID::MouseWheel, 0, value, x, y); }
+		constexpr step move(int x, int y) { return impl::make(ID::MouseMove, 0, x, y); }
+
+		constexpr step down(char k) { return impl::make(ID::KeyDown, impl::key(k)); }
+		constexpr step down(keyboard::key k) { return impl::make(ID::KeyDown, impl::key(k)); }
+		constexpr step up(char k) { return impl::make(ID::KeyUp, impl::key(k)); }
+		constexpr step up(keyboard::key k) { return impl::make(ID::KeyUp, impl::key(k)); }
+		constexpr step press(char k) { return impl::make(ID::KeyPress, impl::key(k)); }
+		constexpr step press(keyboard::key k) { return impl::make(ID::KeyPress, impl::key(k)); }
+		constexpr step type(const char* text) { return impl::make(ID::KeyType, 0, 0, 0, 0, impl::text(text)); }
+		constexpr step text(const char* text, long long rate = 0) { return impl::make(ID::KeyText, 0, 0, impl::rate(rate), 0, text); }
+
+		constexpr step idle(long long timeout) { return impl::make(ID::Idle, 0, impl::millisecs(timeout)); }
+		constexpr step window(const char* title, long long timeout) { return impl::make(ID::Window, 0, 0, impl::millisecs(timeout), 0, title); }
+		constexpr step focus(const char* title, long long timeout) { return impl::make(ID::Focus, 0, 0, impl::millisecs(timeout), 0, title); }
+		constexpr step until(const char* name, long long timeout) { return impl::make(ID::Until, 0, 0, impl::millisecs(timeout), 0, name); }
+
+		// inject a step as the action it stands for, constructed on the stack and called as its own type...
+		inline void inject(const step& s)
+		{
+			switch (s.op_)
+			{
+			case ID::Exec:
+				// the target is run by whoever plays the script, as with any other...
+				break;
+			case ID::Wait:
+				program::wait(static_cast<unsigned int>(s.a_)).inject();
+				break;
+			case ID::MouseDown:
+				mouse::down(static_cast<mouse::button>(s.arg_), s.a_, s.b_).inject();
+				break;
+			case ID::MouseUp:
+				mouse::up(static_cast<mouse::button>(s.arg_), s.a_, s.b_).inject();
+				break;
+			case ID::MouseWheel:
+				mouse::wheel(s.a_, s.b_, s.c_).inject();
+				break;
+			case ID::MouseMove:
+				mouse::move(s.a_, s.b_).inject();
+				break;
+			case ID::KeyDown:
+				keyboard::down(s.arg_).inject();
+				break;
+			case ID::KeyUp:
+				keyboard::up(s.arg_).inject();
+				break;
+			case ID::KeyPress:
+				keyboard::press(s.arg_).inject();
+				break;
+			case ID::KeyType:
+				for (const char* c = s.text_; *c; ++c)
+					keyboard::press(static_cast<unsigned char>(*c)).inject();
+				break;
+			case ID::KeyText:
+			{
+				const char* end = s.text_;
+				while (*end)
+					++end;
+				keyboard::text::inject(s.text_, end, static_cast<unsigned int>(s.b_));
+				break;
+			}
+			case ID::Idle:
+				program::idle::inject(static_cast<unsigned int>(s.a_));
+				break;
+			case ID::Window:
+			case ID::Focus:
+				program::window::inject(s.text_, static_cast<unsigned int>(s.b_), s.op_ == ID::Focus);
+				break;
+			case ID::Until:
+				program::until::inject(s.text_, static_cast<unsigned int>(s.b_));
+				break;
+			}
+		}
+
+		// hand a step to f as the action it stands for, which bursts need to lower it. Typing is a press for each
+		// character, text and the waits for conditions copy their strings...
+		template<typename F>
+		inline void visit(const step& s, F f)
+		{
+			switch (s.op_)
+			{
+			case ID::Exec:
+				break;
+			case ID::Wait:
+				f(program::wait(static_cast<unsigned int>(s.a_)));
+				break;
+			case ID::MouseDown:
+				f(mouse::down(static_cast<mouse::button>(s.arg_), s.a_, s.b_));
+				break;
+			case ID::MouseUp:
+				f(mouse::up(static_cast<mouse::button>(s.arg_), s.a_, s.b_));
+				break;
+			case ID::MouseWheel:
+				f(mouse::wheel(s.a_, s.b_, s.c_));
+				break;
+			case ID::MouseMove:
+				f(mouse::move(s.a_, s.b_));
+				break;
+			case ID::KeyDown:
+				f(keyboard::down(s.arg_));
+				break;
+			case ID::KeyUp:
+				f(keyboard::up(s.arg_));
+				break;
+			case ID::KeyPress:
+				f(keyboard::press(s.arg_));
+				break;
+			case ID::KeyType:
+				for (const char* c = s.text_; *c; ++c)
+					f(keyboard::press(static_cast<unsigned char>(*c)));
+				break;
+			case ID::KeyText:
+				f(keyboard::text(s.text_, static_cast<unsigned int>(s.b_)));
+				break;
+			case ID::Idle:
+				f(program::idle(static_cast<unsigned int>(s.a_)));
+				break;
+			case ID::Window:
+				f(program::window(s.text_, static_cast<unsigned int>(s.b_)));
+				break;
+			case ID::Focus:
+				f(program::focus(s.text_, static_cast<unsigned int>(s.b_)));
+				break;
+			case ID::Until:
+				f(program::until(s.text_, static_cast<unsigned int>(s.b_)));
+				break;
+			}
+		}
+
+		template<std::size_t N>
+		struct sequence
+		{
+			step steps_[N];
+
+			constexpr std::size_t size() const { return N; }
+			constexpr const step& operator[](std::size_t i) const { return steps_[i]; }
+
+			// the program the leading exec names, not yet run...
+			program::exec target() const { return program::exec(steps_[0].text_); }
+
+			// playing skips the leading exec, the target is not run. Run target() first if it is needed...
+			playStats play() const
+			{
+				return play(backend::current(), playback());
+			}
+
+			playStats play(backend& b) const
+			{
+				return play(b, playback());
+			}
+
+			playStats play(backend& b, const playback& options) const
+			{
+				playStats stats;
+				backend::scope scope(b);
+				{
+					timeline clock(options, stats);
+					if (options.burst_)
+					{
+						// bursts are batched as an image's are...
+						plan held;
+						plan::batch burst(b, clock, options.burst_, held);
+						for (std::size_t i = 0; i < N; ++i)
+							visit(steps_[i], [&burst](const auto& a) { burst(a); });
+						burst.flush();
+					}
+					else
+					{
+						for (std::size_t i = 0; i < N; ++i)
+						{
+							const step& s = steps_[i];
+							clock.measure(s.op_, true, [&s]() { inject(s); });
+						}
+					}
+				}
+				return stats;
+			}
+		};
+
+		template<typename... Steps>
+		constexpr sequence<sizeof...(Steps) + 1> script(const step& first, const Steps&... rest)
+		{
+			return first.op_ == ID::Exec ? sequence<sizeof...(Steps) + 1>{ { first, rest... } } : throw std::logic_error("A script starts with exec");
+		}
+	}
+
+	
+	// a script syntax error and where it is...
+	class syntaxError : public std::runtime_error
+	{
+		std::size_t line_, column_;
+	public:
+		syntaxError(const std::string& msg, std::size_t line, std::size_t column)
+			: std::runtime_error(msg + " at line " + std::to_string(line) + ", column " + std::to_string(column)), line_(line), column_(column) {}
+
+		std::size_t line() const { return line_; }
+		std::size_t column() const { return column_; }
+	};
+
+	namespace impl
+	{
+		// a single pass over script syntax which hands each action to a visitor as it is read. Nothing is copied
+		// other than the text exec and type actions hold...
+		class parser
+		{
+			const char* itr_;
+			const char* end_;
+			const char* lineStart_;
+			std::size_t line_;
+
+		public:
+			parser(const char* begin, const char* end, std::size_t line = 1)
+				: itr_(begin), end_(end), lineStart_(begin), line_(line) {}
+
+			template<typename F>
+			void visit(F f)
+			{
+				skip();
+				while (itr_ != end_)
+				{
+					const char* opStart = itr_;
+					while (itr_ != end_ && ((*itr_ >= 'a' && *itr_ <= 'z') || (*itr_ >= 'A' && *itr_ <= 'Z')))
+						++itr_;
+					if (itr_ == opStart)
+						error("Expected an action");
+					unsigned int id = op(opStart, itr_);
+
+					skip();
+					expect('{');
+					switch (id)
+					{
+					case ID::Exec:
+						f(program::exec(text()));
+						break;
+					case ID::Wait:
+					{
+						unsigned int millisecs = static_cast<unsigned int>(number(0, 0x7fffffff));
+						close();
+						f(program::wait(millisecs));
+						break;
+					}
+					case ID::MouseDown:
+					case ID::MouseUp:
+					{
+						mouse::button b = button();
+						int x = number();
+						int y = number();
+						close();
+						if (id == ID::MouseDown)
+							f(mouse::down(b, x, y));
+						else
+							f(mouse::up(b, x, y));
+						break;
+					}
+					case ID::MouseWheel:
+					{
+						int value = number();
+						int x = number();
+						int y = number();
+						close();
+						f(mouse::wheel(value, x, y));
+						break;
+					}
+					case ID::MouseMove:
+					{
+						int x = number();
+						int y = number();
+						close();
+						f(mouse::move(x, y));
+						break;
+					}
+					case ID::KeyDown:
+					case ID::KeyUp:
+					case ID::KeyPress:
+					{
+						unsigned char k = static_cast<unsigned char>(number(0, 255));
+						close();
+						if (id == ID::KeyDown)
+							f(keyboard::down(k));
+						else if (id == ID::KeyUp)
+							f(keyboard::up(k));
+						else
+							f(keyboard::press(k));
+						break;
+					}
+					case ID::KeyType:
+						f(keyboard::type(text()));
+						break;
+					case ID::KeyText:
+					{
+						unsigned int rate = static_cast<unsigned int>(number(0, 0x7fffffff));
+						skip();
+						expect(',');
+						f(keyboard::text(text(), rate));
+						break;
+					}
+					case ID::Idle:
+					{
+						unsigned int timeout = static_cast<unsigned int>(number(0, 0x7fffffff));
+						close();
+						f(program::idle(timeout));
+						break;
+					}
+					case ID::Window:
+					case ID::Focus:
+					case ID::Until:
+					{
+						unsigned int timeout = static_cast<unsigned int>(number(0, 0x7fffffff));
+						skip();
+						expect(',');
+						if (id == ID::Window)
+							f(program::window(text(), timeout));
+						else if (id == ID::Focus)
+							f(program::focus(text(), timeout));
+						else
+							f(program::until(text(), timeout));
+						break;
+					}
+					default:
+						itr_ = opStart;
+						error("Unknown action syntax");
+					}
+
+					// actions are separated by commas, the last one may have one too...
+					skip();
+					if (itr_ != end_)
+					{
+						expect(',');
+						skip();
+					}
+				}
+			}
+
+		private:
+			[[noreturn]] void error(const char* msg) const
+			{
+				throw syntaxError(msg, line_, static_cast<std::size_t>(itr_ - lineStart_) + 1);
+			}
+
+			void skip()
+			{
+				for (; itr_ != end_; ++itr_)
+				{
+					if (*itr_ == '\n')
+					{
+						++line_;
+						lineStart_ = itr_ + 1;
+					}
+					else if (*itr_ != ' ' && *itr_ != '\t' && *itr_ != '\r')
+						break;
+				}
+			}
+
+			void expect(char c)
+			{
+				if (itr_ == end_ || *itr_ != c)
+				{
+					char msg[] = "Expected ' '";
+					msg[10] = c;
+					error(msg);
+				}
+				++itr_;
+			}
+
+			static unsigned int op(const char* begin, const char* end)
+			{
+				std::size_t length = static_cast<std::size_t>(end - begin);
+				for (unsigned int id = ID::Exec; id < ID::CairoElephant; ++id)
+					if (ID::str[id].size() == length && std::equal(begin, end, ID::str[id].begin()))
+						return id;
+				if (length == 4 && std::equal(begin, end, "type"))
+					return ID::KeyType;
+				return ID::CairoElephant;
+			}
+
+			int number(std::int64_t least = -0x80000000LL, std::int64_t most = 0x7fffffff)
+			{
+				skip();
+				const char* start = itr_;
+				bool negative = itr_ != end_ && *itr_ == '-';
+				if (negative)
+					++itr_;
+
+				const char* digits = itr_;
+				std::int64_t value = 0;
+				for (; itr_ != end_ && *itr_ >= '0' && *itr_ <= '9'; ++itr_)
+				{
+					value = value * 10 + (*itr_ - '0');
+					if (value > 0x80000000LL)
+					{
+						itr_ = start;
+						error("Number out of range");
+					}
+				}
+				if (itr_ == digits)
+					error("Expected a number");
+
+				if (negative)
+					value = -value;
+				if (value < least || value > most)
+				{
+					itr_ = start;
+					error("Number out of range");
+				}
+
+				return static_cast<int>(value);
+			}
+
+			// the end of some args...
+			void close()
+			{
+				skip();
+				expect('}');
+			}
+
+			mouse::button button()
+			{
+				skip();
+				const char* start = itr_;
+				while (itr_ != end_ && *itr_ != ' ' && *itr_ != '\t' && *itr_ != '\r' && *itr_ != '\n' && *itr_ != '}')
+					++itr_;
+				for (unsigned int id = mouse::button::None; id <= mouse::button::CairoElephant; ++id)
+					if (mouse::buttonStr[id].size() == static_cast<std::size_t>(itr_ - start) && std::equal(start, itr_, mouse::buttonStr[id].begin()))
+						return static_cast<mouse::button>(id);
+				itr_ = start;
+				error("Unknown mouse button");
+			}
+
+			// everything up to the closing brace, less surrounding spaces and any line ends...
+			std::string text()
+			{
+				const char* start = itr_;
+				const char* close = std::find(itr_, end_, '}');
+				if (close == end_)
+					error("Expected '}'");
+
+				while (start != close && *start == ' ')
+					++start;
+				const char* finish = close;
+				while (finish != start && *(finish - 1) == ' ')
+					--finish;
+
+				std::string result;
+				if (std::find(start, finish, '\n') == finish)
+					result.assign(start, finish);
+				else
+				{
+					result.reserve(static_cast<std::size_t>(finish - start));
+					for (const char* c = start; c != finish; ++c)
+						if (*c != '\n')
+							result.push_back(*c);
+				}
+
+				for (; itr_ != close; ++itr_)
+					if (*itr_ == '\n')
+					{
+						++line_;
+						lineStart_ = itr_ + 1;
+					}
+				++itr_;
+				return result;
+			}
+		};
+	}
+
+	namespace binary
+	{
+		// the header and opcode table which start a binary script...
+		inline std::string prologue(std::uint64_t records)
+		{
+			std::size_t tableSize = static_cast<std::size_t>(payload(ID::CairoElephant * sizeof(opcode))) * sizeof(record);
+
+			std::string result(sizeof(header) + tableSize, '\0');
+			opcode* table = reinterpret_cast<opcode*>(&result[sizeof(header)]);
+			for (unsigned int id = ID::Exec; id < ID::CairoElephant; ++id)
+				ID::str[id].copy(table[id].name_, sizeof(table[id].name_));
+
+			header h = {};
+			std::copy(magic, magic + 4, h.magic_);
+			h.version_ = version;
+			h.recordSize_ = sizeof(record);
+			h.opcodes_ = ID::CairoElephant;
+			h.records_ = records;
+			std::copy(reinterpret_cast<const char*>(&h), reinterpret_cast<const char*>(&h) + sizeof(h), result.begin());
+
+			return result;
+		}
+
+		// construct the action at r with id on the stack and hand it to f, returns the payload slots it used out of
+		// those available after it...
+		template<typename F>
+		std::uint64_t decode(const record& r, std::uint64_t available, std::uint8_t id, F& f)
+		{
+			const char* text = reinterpret_cast<const char*>(&r + 1);
+			std::uint64_t length = 0;
+			if (ID::text(id))
+			{
+				length = static_cast<std::uint32_t>(r.a_);
+				if (payload(length) > available)
+					throw std::runtime_error("Binary script truncated.");
+			}
+
+			switch (id)
+			{
+			case ID::Exec:
+				f(program::exec(std::string(text, static_cast<std::size_t>(length))));
+				break;
+			case ID::Wait:
+				f(program::wait(static_cast<unsigned int>(r.a_)));
+				break;
+			case ID::MouseDown:
+				f(mouse::down(static_cast<mouse::button>(r.arg_), r.a_, r.b_));
+				break;
+			case ID::MouseUp:
+				f(mouse::up(static_cast<mouse::button>(r.arg_), r.a_, r.b_));
+				break;
+			case ID::MouseWheel:
+				f(mouse::wheel(r.a_, r.b_, r.c_));
+				break;
+			case ID::MouseMove:
+				f(mouse::move(r.a_, r.b_));
+				break;
+			case ID::KeyDown:
+				f(keyboard::down(r.arg_));
+				break;
+			case ID::KeyUp:
+				f(keyboard::up(r.arg_));
+				break;
+			case ID::KeyPress:
+				f(keyboard::press(r.arg_));
+				break;
+			case ID::KeyType:
+				f(keyboard::type(std::string(text, static_cast<std::size_t>(length))));
+				break;
+			case ID::KeyText:
+				f(keyboard::text(std::string(text, static_cast<std::size_t>(length)), static_cast<unsigned int>(r.b_)));
+				break;
+			case ID::Idle:
+				f(program::idle(static_cast<unsigned int>(r.a_)));
+				break;
+			case ID::Window:
+				f(program::window(std::string(text, static_cast<std::size_t>(length)), static_cast<unsigned int>(r.b_)));
+				break;
+			case ID::Focus:
+				f(program::focus(std::string(text, static_cast<std::size_t>(length)), static_cast<unsigned int>(r.b_)));
+				break;
+			case ID::Until:
+				f(program::until(std::string(text, static_cast<std::size_t>(length)), static_cast<unsigned int>(r.b_)));
+				break;
+			default:
+				throw std::runtime_error("Unknown action in binary script.");
+			}
+
+			return payload(length);
+		}
+	}
+
+	namespace impl
+	{
+		// script syntax written through a fixed buffer, which is handed to out whenever it fills. Actions with a binary
+		// form are written straight from their records, so nothing is constructed or allocated per action. Numbers are
+		// formatted here as std::to_chars needs C++17...
+		template<typename Out>
+		class syntaxWriter
+		{
+		public:
+			explicit syntaxWriter(Out& out)
+				: out_(out), used_(0) {}
+
+			// the action at r as its syntax() would have it followed by a comma, returns the payload slots it used
+			// out of those available after it like binary::decode...
+			std::uint64_t action(const binary::record& r, std::uint64_t available, std::uint8_t id)
+			{
+				const char* payload = reinterpret_cast<const char*>(&r + 1);
+				std::uint64_t length = 0;
+				if (ID::text(id))
+				{
+					length = static_cast<std::uint32_t>(r.a_);
+					if (binary::payload(length) > available)
+						throw std::runtime_error("Binary script truncated.");
+				}
+
+				if (id >= ID::CairoElephant)
+					throw std::runtime_error("Unknown action in binary script.");
+				text(ID::str[id]);
+				text(" {", 2);
+
+				switch (id)
+				{
+				case ID::Exec:
+				case ID::KeyType:
+					text(payload, static_cast<std::size_t>(length));
+					break;
+				case ID::KeyText:
+				case ID::Window:
+				case ID::Focus:
+				case ID::Until:
+					number(static_cast<std::uint32_t>(r.b_));
+					text(",", 1);
+					text(payload, static_cast<std::size_t>(length));
+					break;
+				case ID::Wait:
+				case ID::Idle:
+					number(static_cast<std::uint32_t>(r.a_));
+					break;
+				case ID::MouseDown:
+				case ID::MouseUp:
+					text(mouse::buttonStr[(std::min)(static_cast<unsigned int>(r.arg_), static_cast<unsigned int>(mouse::button::CairoElephant))]);
+					text(" ", 1);
+					point(r.a_, r.b_);
+					break;
+				case ID::MouseWheel:
+					number(r.a_);
+					text(" ", 1);
+					point(r.b_, r.c_);
+					break;
+				case ID::MouseMove:
+					point(r.a_, r.b_);
+					break;
+				default:
+					// keys...
+					number(r.arg_);
+					break;
+				}
+
+				text("},", 2);
+				return binary::payload(length);
+			}
+
+			// an action without a binary form...
+			void action(const injectable& a)
+			{
+				text(a.syntax());
+				text(",", 1);
+			}
+
+			// hand on whatever is buffered...
+			void flush()
+			{
+				if (used_)
+					out_(buffer_, used_);
+				used_ = 0;
+			}
+
+		private:
+			void text(const std::string& str) { text(str.data(), str.size()); }
+
+			void text(const char* str, std::size_t size)
+			{
+				if (size > sizeof(buffer_) - used_)
+				{
+					flush();
+					// too long to be worth copying...
+					if (size > sizeof(buffer_) / 2)
+					{
+						out_(str, size);
+						return;
+					}
+				}
+				std::copy(str, str + size, buffer_ + used_);
+				used_ += size;
+			}
+
+			void number(std::int64_t value)
+			{
+				char digits[24];
+				char* end = digits + sizeof(digits);
+				char* begin = end;
+				std::uint64_t magnitude = value < 0 ? 0 - static_cast<std::uint64_t>(value) : static_cast<std::uint64_t>(value);
+				do
+				{
+					*--begin = static_cast<char>('0' + magnitude % 10);
+					magnitude /= 10;
+				} while (magnitude);
+				if (value < 0)
+					*--begin = '-';
+				text(begin, static_cast<std::size_t>(end - begin));
+			}
+
+			void point(std::int32_t x, std::int32_t y)
+			{
+				number(x);
+				text(" ", 1);
+				number(y);
+			}
+
+			Out& out_;
+			std::size_t used_;
+			char buffer_[1 << 14];
+		};
+	}
+
+	inline std::string logger::format(const entry& e)
+	{
+		static const char* const severities[] = { "trace", "debug", "info", "warning", "error", "off" };
+
+		std::ostringstream oss;
+		oss.precision(6);
+		oss << std::fixed << e.time_ / 1e9 << " " << severities[(std::min)(e.severity_, static_cast<std::uint8_t>(Off))] << " " << e.what_;
+		if (e.session_)
+			oss << " session " << e.session_;
+		oss << " thread " << e.thread_;
+
+		// text is not kept, only its length...
+		std::uint8_t op = e.action_.op_;
+		if (op < ID::CairoElephant)
+		{
+			if (!e.args_)
+				oss << ": " << ID::str[op];
+			else if (ID::text(op))
+				oss << ": " << ID::str[op] << " {" << static_cast<std::uint32_t>(e.action_.a_) << " bytes}";
+			else
+			{
+				auto f = [&oss](const injectable& a) { oss << ": " << a.syntax(); };
+				binary::decode(e.action_, 0, op, f);
+			}
+		}
+		return oss.str();
+	}
+
+	namespace impl
+	{
+		// a monotonic arena. Memory is handed out in order from large blocks, nothing is freed until the arena is...
+		class arena
+		{
+			struct block
+			{
+				block* next_;
+			};
+
+			block* blocks_;
+			char* itr_;
+			char* end_;
+			std::size_t next_;
+
+		public:
+			arena()
+				: blocks_(nullptr), itr_(nullptr), end_(nullptr), next_(1 << 16) {}
+
+			~arena()
+			{
+				while (blocks_)
+				{
+					block* b = blocks_;
+					blocks_ = b->next_;
+					::operator delete(b);
+				}
+			}
+
+			void* allocate(std::size_t bytes, std::size_t align)
+			{
+				std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(itr_) + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+				if (!itr_ || p + bytes > reinterpret_cast<std::uintptr_t>(end_))
+				{
+					grow(bytes + align);
+					p = (reinterpret_cast<std::uintptr_t>(itr_) + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+				}
+				itr_ = reinterpret_cast<char*>(p + bytes);
+				return reinterpret_cast<void*>(p);
+			}
+
+			// take the blocks of another arena, which is left empty...
+			void adopt(arena& other)
+			{
+				block** tail = &blocks_;
+				while (*tail)
+					tail = &(*tail)->next_;
+				*tail = other.blocks_;
+				other.blocks_ = nullptr;
+				other.itr_ = other.end_ = nullptr;
+			}
+
+		private:
+			void grow(std::size_t least)
+			{
+				std::size_t size = (std::max)(next_, least + sizeof(block));
+				block* b = static_cast<block*>(::operator new(size));
+				b->next_ = blocks_;
+				blocks_ = b;
+				itr_ = reinterpret_cast<char*>(b + 1);
+				end_ = reinterpret_cast<char*>(b) + size;
+
+				// grow geometrically up to 64MB blocks...
+				next_ = (std::min<std::size_t>)(next_ * 2, 1 << 26);
+			}
+
+			arena(const arena&);
+			arena& operator=(const arena&);
+		};
+
+		// allocates from an arena and keeps it alive, for objects which may outlive what made them...
+		template<typename T>
+		struct arenaAllocator
+		{
+			typedef T value_type;
+
+			arenaAllocator(const std::shared_ptr<arena>& a)
+				: arena_(a) {}
+			template<typename U>
+			arenaAllocator(const arenaAllocator<U>& other)
+				: arena_(other.arena_) {}
+
+			T* allocate(std::size_t n) { return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T))); }
+			void deallocate(T*, std::size_t) {}
+
+			template<typename U>
+			bool operator==(const arenaAllocator<U>& other) const { return arena_ == other.arena_; }
+			template<typename U>
+			bool operator!=(const arenaAllocator<U>& other) const { return arena_ != other.arena_; }
+
+			std::shared_ptr<arena> arena_;
+		};
+	}
+
+	// a sequence of actions. Actions with a binary form are held by value as binary records and replayed by switching
+	// on their op, any others are held as they are and injected through injectable. Everything a script makes is
+	// allocated from its own arena, records in chunks which grow so recording never copies what it has...
+	class script
+	{
+		friend class player;
+
+		// op of a record standing in for an action without a binary form, a_ is its index in custom_...
+		static const std::uint8_t custom = 0xff;
+
+		struct chunk
+		{
+			chunk* next_;
+			std::size_t used_;
+			std::size_t capacity_;
+
+			binary::record* records() { return reinterpret_cast<binary::record*>(this + 1); }
+			const binary::record* records() const { return reinterpret_cast<const binary::record*>(this + 1); }
+		};
+
+		std::shared_ptr<impl::arena> arena_;
+		chunk* first_;
+		chunk* last_;
+		std::vector<action> custom_;
+		std::size_t size_;
+		std::uint64_t slots_;
+		std::shared_ptr<const plan> compiled_;	// for bursts, until the script changes
+
+		// n contiguous slots at the end...
+		binary::record* slots(std::size_t n)
+		{
+			if (compiled_)
+				compiled_.reset();
+			if (!last_ || last_->used_ + n > last_->capacity_)
+			{
+				std::size_t capacity = (std::max)(n, last_ ? (std::min<std::size_t>)(last_->capacity_ * 2, 1 << 20) : 1 << 10);
+				chunk* c = static_cast<chunk*>(arena_->allocate(sizeof(chunk) + capacity * sizeof(binary::record), alignof(chunk)));
+				c->next_ = nullptr;
+				c->used_ = 0;
+				c->capacity_ = capacity;
+				if (last_)
+					last_->next_ = c;
+				else
+					first_ = c;
+				last_ = c;
+			}
+
+			binary::record* result = last_->records() + last_->used_;
+			last_->used_ += n;
+			slots_ += n;
+			return result;
+		}
+
+		// an action as a record and any payload after it, false if it has no binary form...
+		bool append(const injectable& a, std::string& text)
+		{
+			binary::record r = {};
+			text.clear();
+			if (!a.encode(r, text))
+				return false;
+
+			std::size_t payload = static_cast<std::size_t>(binary::payload(text.size()));
+			binary::record* slot = slots(1 + payload);
+			*slot = r;
+			if (payload)
+			{
+				std::fill(slot + 1, slot + 1 + payload, binary::record());
+				text.copy(reinterpret_cast<char*>(slot + 1), text.size());
+			}
+			++size_;
+			return true;
+		}
+
+		// move the actions of another script onto the end of this one...
+		void splice(script& other)
+		{
+			if (!other.first_)
+				return;
+			compiled_.reset();
+			arena_->adopt(*other.arena_);
+			if (last_)
+				last_->next_ = other.first_;
+			else
+				first_ = other.first_;
+			last_ = other.last_;
+			size_ += other.size_;
+			slots_ += other.slots_;
+
+			other.first_ = other.last_ = nullptr;
+			other.size_ = 0;
+			other.slots_ = 0;
+		}
+
+		void parse(const char* begin, const char* end)
+		{
+			std::string text;
+			impl::parser(begin, end).visit([this, &text](const injectable& a) { append(a, text); });
+		}
+
+		// an error in text which starts lines and column into the script...
+		static syntaxError relocate(const syntaxError& e, std::size_t lines, std::size_t column)
+		{
+			std::string msg = e.what();
+			return syntaxError(msg.substr(0, msg.rfind(" at line ")), e.line() + lines, e.line() == 1 ? e.column() + column : e.column());
+		}
+
+		// the syntax of each action in turn through out...
+		template<typename Out>
+		void write(Out& out) const
+		{
+			impl::syntaxWriter<Out> w(out);
+			for (const chunk* c = first_; c; c = c->next_)
+			{
+				const binary::record* records = c->records();
+				for (std::size_t i = 0; i < c->used_; ++i)
+				{
+					if (records[i].op_ == custom)
+						w.action(*custom_[static_cast<std::size_t>(records[i].a_)]);
+					else
+						i += static_cast<std::size_t>(w.action(records[i], c->used_ - i - 1, records[i].op_));
+				}
+			}
+			w.flush();
+		}
+
+		static void parseChunk(const std::vector<const char*>& bounds, std::size_t chunk, script& parsed, std::exception_ptr& error)
+		{
+			try
+			{
+				parsed.parse(bounds[chunk], bounds[chunk + 1]);
+			}
+			catch (const syntaxError& e)
+			{
+				// chunks are parsed as if they start a script, move the position to where the chunk really is...
+				const char* begin = bounds.front();
+				const char* start = bounds[chunk];
+				std::size_t lines = static_cast<std::size_t>(std::count(begin, start, '\n'));
+				std::size_t column = static_cast<std::size_t>(start - std::find(std::reverse_iterator<const char*>(start), std::reverse_iterator<const char*>(begin), '\n').base());
+				error = std::make_exception_ptr(relocate(e, lines, column));
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+		}
+
+		// visit the records in order, g handles those standing in for custom actions...
+		template<typename F, typename G>
+		void walk(F& f, G g) const
+		{
+			for (const chunk* c = first_; c; c = c->next_)
+			{
+				const binary::record* records = c->records();
+				for (std::size_t i = 0; i < c->used_; ++i)
+				{
+					if (records[i].op_ == custom)
+						g(custom_[static_cast<std::size_t>(records[i].a_)]);
+					else
+						i += static_cast<std::size_t>(binary::decode(records[i], c->used_ - i - 1, records[i].op_, f));
+				}
+			}
+		}
+		
+	public:
+
+		script(const std::string& scriptSyntax)
+			: arena_(std::make_shared<impl::arena>()), first_(nullptr), last_(nullptr), size_(0), slots_(0)
+		{
+			const char* begin = scriptSyntax.data();
+			parse(begin, begin + scriptSyntax.size());
+		}
+
+		// parse large scripts in chunks on this many threads, zero for one per core...
+		script(const std::string& scriptSyntax, unsigned int threads)
+			: arena_(std::make_shared<impl::arena>()), first_(nullptr), last_(nullptr), size_(0), slots_(0)
+		{
+			const char* begin = scriptSyntax.data();
+			const char* end = begin + scriptSyntax.size();
+
+			// not worth a thread for less than this...
+			const std::size_t least = 1 << 16;
+			if (!threads)
+				threads = (std::max)(1u, std::thread::hardware_concurrency());
+			threads = static_cast<unsigned int>((std::min<std::size_t>)(threads, scriptSyntax.size() / least + 1));
+
+			// split after the first comma following a closing brace, which is always between two actions
+			// as args cannot contain braces...
+			std::vector<const char*> bounds(1, begin);
+			for (unsigned int t = 1; t < threads; ++t)
+			{
+				const char* itr = (std::max)(bounds.back(), begin + scriptSyntax.size() / threads * t);
+				itr = std::find(std::find(itr, end, '}'), end, ',');
+				if (itr != end)
+					bounds.push_back(itr + 1);
+			}
+			bounds.push_back(end);
+
+			// each chunk has its own arena, so the threads do not share an allocator and the results are
+			// stitched together without copying...
+			std::size_t chunks = bounds.size() - 1;
+			std::vector<script> parsed(chunks);
+			std::vector<std::exception_ptr> errors(chunks);
+			std::vector<std::thread> workers;
+			for (std::size_t c = 1; c < chunks; ++c)
+				workers.push_back(std::thread([&, c]() { parseChunk(bounds, c, parsed[c], errors[c]); }));
+			parseChunk(bounds, 0, *this, errors[0]);
+			std::for_each(workers.begin(), workers.end(), [](std::thread& t) { t.join(); });
+
+			for (std::size_t c = 0; c < chunks; ++c)
+			{
+				if (errors[c])
+					std::rethrow_exception(errors[c]);
+				splice(parsed[c]);
+			}
+		}
+
+		script()
+			: arena_(std::make_shared<impl::arena>()), first_(nullptr), last_(nullptr), size_(0), slots_(0)
+		{
+		}
+
+		script(const script& other)
+			: arena_(std::make_shared<impl::arena>()), first_(nullptr), last_(nullptr), custom_(other.custom_), size_(other.size_), slots_(0)
+		{
+			if (other.slots_)
+			{
+				binary::record* copy = slots(static_cast<std::size_t>(other.slots_));
+				for (const chunk* c = other.first_; c; c = c->next_)
+					copy = std::copy(c->records(), c->records() + c->used_, copy);
+			}
+		}
+
+		script(script&& other)
+			: arena_(std::make_shared<impl::arena>()), first_(nullptr), last_(nullptr), size_(0), slots_(0)
+		{
+			swap(other);
+		}
+
+		script& operator=(script other)
+		{
+			swap(other);
+			return *this;
+		}
+
+		void swap(script& other)
+		{
+			std::swap(arena_, other.arena_);
+			std::swap(first_, other.first_);
+			std::swap(last_, other.last_);
+			std::swap(custom_, other.custom_);
+			std::swap(size_, other.size_);
+			std::swap(slots_, other.slots_);
+			std::swap(compiled_, other.compiled_);
+		}
+
+		playStats play()
+		{
+			return play(backend::current(), playback());
+		}
+
+		// play through a specific backend rather than the current one...
+		playStats play(backend& b)
+		{
+			return play(b, playback());
+		}
+
+		// play with options, bursts are sent from a plan compiled by the first and kept until the script changes...
+		playStats play(const playback& options)
+		{
+			return play(backend::current(), options);
+		}
+
+		playStats play(backend& b, const playback& options)
+		{
+			// check first action is program::exec...
+			//if ( )
+
+			if (options.burst_)
+			{
+				std::shared_ptr<const plan> compiled = std::atomic_load(&compiled_);
+				if (!compiled)
+				{
+					compiled = std::make_shared<const plan>(compile());
+					std::atomic_store(&compiled_, compiled);
+				}
+				return compiled->play(b, options);
+			}
+
+			playStats stats;
+			backend::scope s(b);
+			{
+				timeline clock(options, stats);
+				visit([&clock](const auto& a) { clock.inject(a); });
+			}
+
+			// return when finished...
+			return stats;
+		}
+
+		void wait()
+		{
+
+		}
+
+		std::string syntax() const
+		{
+			std::string result;
+			syntax(result);
+			return result;
+		}
+
+		// append the syntax to text, whose capacity is reused by writing into the same string again...
+		void syntax(std::string& text) const
+		{
+			auto out = [&text](const char* data, std::size_t size) { text.append(data, size); };
+			write(out);
+		}
+
+		// write the syntax to a file as it is formatted...
+		void syntax(std::FILE* file) const
+		{
+			bool failed = false;
+			auto out = [file, &failed](const char* data, std::size_t size) { failed = std::fwrite(data, 1, size, file) != size || failed; };
+			write(out);
+			if (failed)
+				throw std::runtime_error("Unable to write script.");
+		}
+
+		void save(const std::string& path) const
+		{
+			std::FILE* file = std::fopen(path.c_str(), "wb");
+			if (!file)
+				throw std::runtime_error("Unable to write script " + path);
+			try
+			{
+				syntax(file);
+			}
+			catch (...)
+			{
+				std::fclose(file);
+				throw std::runtime_error("Unable to write script " + path);
+			}
+			if (std::fclose(file))
+				throw std::runtime_error("Unable to write script " + path);
+		}
+
+		// the script in the binary format, see binary::image...
+		std::string binary() const
+		{
+			if (!custom_.empty())
+				throw std::runtime_error("Action has no binary form, " + custom_.front()->op());
+
+			std::string result = binary::prologue(slots_);
+			result.reserve(result.size() + static_cast<std::size_t>(slots_) * sizeof(binary::record));
+			for (const chunk* c = first_; c; c = c->next_)
+				result.append(reinterpret_cast<const char*>(c->records()), c->used_ * sizeof(binary::record));
+			return result;
+		}
+
+		void add(action a)
+		{
+			std::string text;
+			if (!append(*a, text))
+			{
+				binary::record* r = slots(1);
+				*r = binary::record();
+				r->op_ = custom;
+				r->a_ = static_cast<std::int32_t>(custom_.size());
+				custom_.push_back(a);
+				++size_;
+			}
+		}
+
+		// add a copy of an action, held by value if it has a binary form and otherwise allocated from the arena...
+		template<typename T>
+		typename std::enable_if<std::is_base_of<injectable, T>::value>::type add(const T& a)
+		{
+			std::string text;
+			if (!append(a, text))
+				add(std::allocate_shared<T>(impl::arenaAllocator<T>(arena_), a));
+		}
+
+		// construct an action in place...
+		template<typename T, typename... Args>
+		void emplace(Args&&... args)
+		{
+			add(T(std::forward<Args>(args)...));
+		}
+
+		// number of actions...
+		std::size_t size() const { return size_; }
+
+		// hand each action to f in turn. Those held by value are constructed on the stack for the call...
+		template<typename F>
+		void visit(F f) const
+		{
+			walk(f, [&f](const action& a) { f(static_cast<const injectable&>(*a)); });
+		}
+
+		// hand the first action to f, if there is one, without decoding the rest...
+		template<typename F>
+		void front(F f) const
+		{
+			for (const chunk* c = first_; c; c = c->next_)
+			{
+				if (!c->used_)
+					continue;
+				const binary::record& r = c->records()[0];
+				if (r.op_ == custom)
+					f(static_cast<const injectable&>(*custom_[static_cast<std::size_t>(r.a_)]));
+				else
+					binary::decode(r, c->used_ - 1, r.op_, f);
+				return;
+			}
+		}
+
+		// lower the script into a plan once, so replaying it repeatedly only sends records...
+		plan compile() const
+		{
+			plan result;
+			auto lower = [&result](const injectable& a) { result.lower(a); };
+			walk(lower, [&result](const action& a)
+			{
+				if (!result.lower(*a))
+					result.call(a);
+			});
+			return result;
+		}
+	
+	};
+
+	namespace binary
+	{
+		// a binary script mapped into memory and replayed straight from the mapped pages...
+		class image
+		{
+		public:
+			// map a file...
+			image(const std::string& path)
+				: data_(nullptr), size_(0), owned_(true)
+			{
+#ifdef GHOST_WINDOWS
+				mapping_ = NULL;
+				file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+				if (file_ == INVALID_HANDLE_VALUE)
+					throw std::runtime_error("Unable to open binary script " + path);
+
+				LARGE_INTEGER size;
+				GetFileSizeEx(file_, &size);
+				size_ = static_cast<std::size_t>(size.QuadPart);
+				if (size_)
+				{
+					mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+					if (mapping_ != NULL)
+						data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+				}
+#else
+				fd_ = ::open(path.c_str(), O_RDONLY);
+				if (fd_ < 0)
+					throw std::runtime_error("Unable to open binary script " + path);
+
+				struct stat st;
+				fstat(fd_, &st);
+				size_ = static_cast<std::size_t>(st.st_size);
+				if (size_)
+				{
+					void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+					if (data != MAP_FAILED)
+					{
+						madvise(data, size_, MADV_SEQUENTIAL);
+						data_ = static_cast<const char*>(data);
+					}
+				}
+#endif
+				if (!data_)
+				{
+					close();
+					throw std::runtime_error("Unable to map binary script " + path);
+				}
+				try
+				{
+					validate();
+				}
+				catch (...)
+				{
+					close();
+					throw;
+				}
+			}
+
+			// bytes already in memory, such as script::binary(), which must outlive the image...
+			image(const void* data, std::size_t size)
+				: data_(static_cast<const char*>(data)), size_(size), owned_(false)
+			{
+				validate();
+			}
+
+			~image()
+			{
+				close();
+			}
+
+			const header& info() const { return *reinterpret_cast<const header*>(data_); }
+
+			// record slots, including payload...
+			std::uint64_t size() const { return count_; }
+
+			playStats play() const
+			{
+				return play(backend::current(), playback());
+			}
+
+			playStats play(backend& b) const
+			{
+				return play(b, playback());
+			}
+
+			playStats play(backend& b, const playback& options) const
+			{
+				playStats stats;
+				backend::scope scope(b);
+				{
+					timeline clock(options, stats);
+					plan held;
+					plan::batch burst(b, clock, options.burst_, held);
+					visit([&burst](const auto& a) { burst(a); });
+					burst.flush();
+				}
+				return stats;
+			}
+
+			// decode into a script...
+			ghost::script script() const
+			{
+				ghost::script result;
+				visit([&result](const auto& a) { result.add(a); });
+				return result;
+			}
+
+			// straight from the records to script syntax, see script::syntax...
+			std::string syntax() const
+			{
+				std::string result;
+				syntax(result);
+				return result;
+			}
+
+			void syntax(std::string& text) const
+			{
+				auto out = [&text](const char* data, std::size_t size) { text.append(data, size); };
+				impl::syntaxWriter<decltype(out)> w(out);
+				each([&w](const record& r, std::uint64_t available, std::uint8_t id) { return w.action(r, available, id); });
+				w.flush();
+			}
+
+			// construct each action on the stack in turn and hand it to f...
+			template<typename F>
+			void visit(F f) const
+			{
+				each([&f](const record& r, std::uint64_t available, std::uint8_t id) { return decode(r, available, id, f); });
+			}
+
+		private:
+			// hand each record, the slots after it and its op to f, which returns the payload slots it used...
+			template<typename F>
+			void each(F f) const
+			{
+				bool live = !info().records_;
+				for (std::uint64_t i = 0; i < count_; ++i)
+				{
+					// a file still being written may end part way through the text of an action...
+					std::uint8_t id = remap_[records_[i].op_];
+					if (live && ID::text(id) && payload(static_cast<std::uint32_t>(records_[i].a_)) > count_ - i - 1)
+						break;
+					i += f(records_[i], count_ - i - 1, id);
+				}
+			}
+
+			void validate()
+			{
+				if (size_ < sizeof(header))
+					throw std::runtime_error("Not a binary script.");
+
+				const header& h = info();
+				if (!std::equal(magic, magic + 4, h.magic_))
+					throw std::runtime_error("Not a binary script.");
+				if (h.version_ > version || h.recordSize_ != sizeof(record))
+					throw std::runtime_error("Unsupported binary script version.");
+
+				std::uint64_t tableSize = payload(static_cast<std::uint64_t>(h.opcodes_) * sizeof(opcode)) * sizeof(record);
+				if (h.opcodes_ > 256 || sizeof(header) + tableSize > size_)
+					throw std::runtime_error("Binary script truncated.");
+
+				// ops are matched by name, so files written with another table still play...
+				std::fill(remap_, remap_ + 256, static_cast<std::uint8_t>(ID::CairoElephant));
+				const opcode* table = reinterpret_cast<const opcode*>(data_ + sizeof(header));
+				for (std::uint32_t op = 0; op < h.opcodes_; ++op)
+				{
+					std::string name(table[op].name_, std::find(table[op].name_, table[op].name_ + sizeof(table[op].name_), '\0'));
+					for (unsigned int id = ID::Exec; id < ID::CairoElephant; ++id)
+						if (ID::str[id] == name)
+							remap_[op] = static_cast<std::uint8_t>(id);
+				}
+
+				// a file still being written has no count yet, take what is there...
+				records_ = reinterpret_cast<const record*>(data_ + sizeof(header) + tableSize);
+				count_ = (size_ - sizeof(header) - tableSize) / sizeof(record);
+				if (h.records_)
+					count_ = (std::min)(count_, h.records_);
+			}
+
+			void close()
+			{
+				if (!owned_)
+					return;
+#ifdef GHOST_WINDOWS
+				if (data_)
+					UnmapViewOfFile(data_);
+				if (mapping_ != NULL)
+					CloseHandle(mapping_);
+				if (file_ != INVALID_HANDLE_VALUE)
+					CloseHandle(file_);
+#else
+				if (data_)
+					munmap(const_cast<char*>(data_), size_);
+				if (fd_ >= 0)
+					::close(fd_);
+#endif
+				data_ = nullptr;
+				owned_ = false;
+			}
+
+			image(const image&);
+			image& operator=(const image&);
+
+			const char* data_;
+			std::size_t size_;
+			bool owned_;
+			const record* records_;
+			std::uint64_t count_;
+			std::uint8_t remap_[256];
+#ifdef GHOST_WINDOWS
+			HANDLE file_;
+			HANDLE mapping_;
+#else
+			int fd_;
+#endif
+		};
+
+		// write a script to a binary file...
+		inline void save(const ghost::script& s, const std::string& path)
+		{
+			std::string bytes = s.binary();
+			std::FILE* file = std::fopen(path.c_str(), "wb");
+			if (!file)
+				throw std::runtime_error("Unable to write binary script " + path);
+			std::size_t written = std::fwrite(bytes.data(), 1, bytes.size(), file);
+			std::fclose(file);
+			if (written != bytes.size())
+				throw std::runtime_error("Unable to write binary script " + path);
+		}
+
+		// appends actions to a binary file as they are added. A background thread writes them out once size bytes
+		// are waiting or interval has passed, and adding waits for it rather than holding more than a few times
+		// size. The file can be opened with image while it is written and holds every action written so far, the
+		// count in the header is filled in on close...
+		class writer
+		{
+		public:
+			writer(const std::string& path, std::size_t size = 1 << 16, std::chrono::milliseconds interval = std::chrono::milliseconds(250))
+				: path_(path), file_(std::fopen(path.c_str(), "wb")), size_((std::max<std::size_t>)(size, sizeof(record))), interval_(interval),
+				slots_(0), written_(0), flush_(0), dropped_(0), closing_(false), failed_(false)
+			{
+				if (!file_)
+					throw std::runtime_error("Unable to write binary script " + path);
+
+				std::string prologue = binary::prologue(0);
+				if (std::fwrite(prologue.data(), 1, prologue.size(), file_) != prologue.size() || std::fflush(file_))
+				{
+					std::fclose(file_);
+					throw std::runtime_error("Unable to write binary script " + path);
+				}
+
+				pending_.reserve(size_);
+				writing_.reserve(size_);
+				thread_ = std::thread([this]() { run(); });
+			}
+
+			~writer()
+			{
+				try
+				{
+					close();
+				}
+				catch (...)
+				{
+				}
+			}
+
+			// actions without a binary form throw. Once writing has failed or the writer is closed, actions are
+			// dropped and counted rather than thrown, as recording adds from its own thread...
+			void add(const injectable& a)
+			{
+				record r = {};
+				std::string text;
+				if (!a.encode(r, text))
+					throw std::runtime_error("Action has no binary form, " + a.op());
+
+				std::size_t length = static_cast<std::size_t>(payload(text.size())) * sizeof(record);
+
+				std::unique_lock<std::mutex> lock(mutex_);
+				space_.wait(lock, [this]() { return pending_.size() < 4 * size_ || failed_; });
+				if (failed_ || closing_)
+				{
+					++dropped_;
+					return;
+				}
+
+				pending_.append(reinterpret_cast<const char*>(&r), sizeof(r));
+				pending_.append(text);
+				pending_.append(length - text.size(), '\0');
+				slots_ += 1 + length / sizeof(record);
+				if (pending_.size() >= size_)
+					ready_.notify_one();
+			}
+
+			// wait until everything added so far is in the file...
+			void flush()
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				std::uint64_t target = slots_;
+				flush_ = (std::max)(flush_, target);
+				ready_.notify_one();
+				space_.wait(lock, [this, target]() { return written_ >= target || failed_; });
+				if (failed_)
+					throw std::runtime_error("Unable to write binary script " + path_);
+			}
+
+			// write what is left and fill in the count...
+			void close()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (!file_)
+						return;
+					closing_ = true;
+				}
+				ready_.notify_one();
+				thread_.join();
+
+				std::string prologue = binary::prologue(slots_);
+				bool failed = failed_ || std::fseek(file_, 0, SEEK_SET) ||
+					std::fwrite(prologue.data(), 1, prologue.size(), file_) != prologue.size();
+				failed = std::fclose(file_) || failed;
+				file_ = nullptr;
+				if (failed)
+					throw std::runtime_error("Unable to write binary script " + path_);
+			}
+
+			// record slots added, including payload...
+			std::uint64_t size() const
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				return slots_;
+			}
+
+			// actions added after writing failed or the writer was closed, none of which are in the file...
+			std::uint64_t dropped() const
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				return dropped_;
+			}
+
+		private:
+			void run()
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				for (;;)
+				{
+					ready_.wait_for(lock, interval_, [this]() { return pending_.size() >= size_ || flush_ > written_ || closing_; });
+
+					if (failed_)
+						pending_.clear();
+					else if (!pending_.empty())
+					{
+						std::uint64_t slots = slots_;
+						pending_.swap(writing_);
+						space_.notify_all();
+
+						// write outside the lock so adding carries on meanwhile...
+						lock.unlock();
+						bool failed = std::fwrite(writing_.data(), 1, writing_.size(), file_) != writing_.size() || std::fflush(file_);
+						writing_.clear();
+						lock.lock();
+
+						failed_ = failed_ || failed;
+						written_ = slots;
+					}
+					else
+						written_ = slots_;
+					space_.notify_all();
+
+					if (closing_ && pending_.empty())
+						return;
+				}
+			}
+
+			writer(const writer&);
+			writer& operator=(const writer&);
+
+			std::string path_;
+			std::FILE* file_;
+			std::size_t size_;
+			std::chrono::milliseconds interval_;
+
+			mutable std::mutex mutex_;
+			std::condition_variable ready_;
+			std::condition_variable space_;
+			std::string pending_;
+			std::string writing_;
+			std::uint64_t slots_;
+			std::uint64_t written_;
+			std::uint64_t flush_;	// slots to be written without waiting for size or interval
+			std::uint64_t dropped_;
+			bool closing_;
+			bool failed_;
+			std::thread thread_;
+		};
+	}
+
+	// plays a script file, text or binary, without loading all of it. A thread reads and decodes the file a window
+	// at a time just ahead of the one playing, so no more than a couple of windows are held however large the file
+	// is. The first window is small so playing starts as soon as the file is opened...
+	class player
+	{
+	public:
+		explicit player(const std::string& path, std::size_t window = 1 << 20)
+			: path_(path), window_((std::max<std::size_t>)(window, 4096)), played_(0)
+		{
+		}
+
+		playStats play()
+		{
+			return play(backend::current(), playback());
+		}
+
+		playStats play(backend& b)
+		{
+			return play(b, playback());
+		}
+
+		// waits are paced and bursts batched as for any other replay...
+		playStats play(backend& b, const playback& options)
+		{
+			std::FILE* file = std::fopen(path_.c_str(), "rb");
+			if (!file)
+				throw std::runtime_error("Unable to read script " + path_);
+
+			queue windows;
+			std::thread reading([this, file, &windows]() { read(file, windows); });
+
+			// the reader is stopped however playing ends...
+			struct finish
+			{
+				queue& windows_;
+				std::thread& reading_;
+				std::FILE* file_;
+				~finish()
+				{
+					windows_.cancel();
+					reading_.join();
+					std::fclose(file_);
+				}
+			} done = { windows, reading, file };
+
+			playStats stats;
+			backend::scope scope(b);
+			{
+				timeline clock(options, stats);
+				plan::batch burst(b, clock, options.burst_, held_);
+				played_ = 0;
+
+				auto f = [this, &burst](const auto& a)
+				{
+					burst(a);
+					++played_;
+				};
+				for (;;)
+				{
+					window w;
+					windows.pop(w);
+					if (!w.binary_.empty())
+						binary::image(w.binary_.data(), w.binary_.size()).visit(f);
+					else
+						w.actions_.visit(f);
+
+					if (w.error_)
+					{
+						burst.flush();
+						std::rethrow_exception(w.error_);
+					}
+					if (w.last_)
+						break;
+				}
+				burst.flush();
+			}
+			return stats;
+		}
+
+		// actions injected by the last play...
+		std::uint64_t size() const { return played_; }
+
+	private:
+		// text is parsed into actions, binary is kept as it is with the prologue in front...
+		struct window
+		{
+			window() : last_(false) {}
+
+			script actions_;
+			std::string binary_;
+			std::exception_ptr error_;
+			bool last_;
+		};
+
+		// the reader waits while two windows are waiting to play...
+		class queue
+		{
+		public:
+			queue() : cancelled_(false) {}
+
+			bool push(window& w)
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				changed_.wait(lock, [this]() { return windows_.size() < 2 || cancelled_; });
+				if (cancelled_)
+					return false;
+				windows_.push_back(window());
+				windows_.back().actions_.swap(w.actions_);
+				windows_.back().binary_.swap(w.binary_);
+				windows_.back().error_ = w.error_;
+				windows_.back().last_ = w.last_;
+				changed_.notify_all();
+				return true;
+			}
+
+			void pop(window& w)
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				changed_.wait(lock, [this]() { return !windows_.empty(); });
+				w.actions_.swap(windows_.front().actions_);
+				w.binary_.swap(windows_.front().binary_);
+				w.error_ = windows_.front().error_;
+				w.last_ = windows_.front().last_;
+				windows_.pop_front();
+				changed_.notify_all();
+			}
+
+			void cancel()
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				cancelled_ = true;
+				changed_.notify_all();
+			}
+
+			bool cancelled()
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				return cancelled_;
+			}
+
+		private:
+			std::mutex mutex_;
+			std::condition_variable changed_;
+			std::list<window> windows_;
+			bool cancelled_;
+		};
+
+		// read up to size more bytes onto the end of buffer, false at the end of the file...
+		static bool fill(std::FILE* file, std::string& buffer, std::size_t size)
+		{
+			std::size_t have = buffer.size();
+			buffer.resize(have + size);
+			std::size_t got = std::fread(&buffer[have], 1, size, file);
+			buffer.resize(have + got);
+			if (got < size && std::ferror(file))
+				throw std::runtime_error("Unable to read script");
+			return got == size;
+		}
+
+		void read(std::FILE* file, queue& windows)
+		{
+			try
+			{
+				std::string buffer;
+				bool more = fill(file, buffer, 4096);
+				if (buffer.size() >= sizeof(binary::magic) && std::equal(binary::magic, binary::magic + sizeof(binary::magic), buffer.data()))
+					readBinary(file, buffer, more, windows);
+				else
+					readText(file, buffer, more, windows);
+			}
+			catch (...)
+			{
+				window w;
+				w.error_ = std::current_exception();
+				w.last_ = true;
+				windows.push(w);
 			}
+		}
+
+		void readText(std::FILE* file, std::string& buffer, bool more, queue& windows)
+		{
+			std::size_t block = 4096, lines = 0, column = 0;
+			for (;;)
+			{
+				const char* begin = buffer.data();
+				const char* end = begin + buffer.size();
+
+				// split after the first comma following a closing brace, as when parsing in parallel. The last
+				// action may not be complete yet, so look back from the end...
+				const char* split = end;
+				if (more)
+				{
+					const char* limit = end;
+					for (;;)
+					{
+						const char* brace = std::find(std::reverse_iterator<const char*>(limit), std::reverse_iterator<const char*>(begin), '}').base();
+						const char* comma = std::find(brace, limit, ',');
+						if (brace == begin || comma != limit)
+						{
+							split = brace == begin ? begin : comma + 1;
+							break;
+						}
+						limit = brace - 1;
+					}
+				}
 
-		protected:
-			void setButton(const std::string& bStr)
-			{
-				for (unsigned int id = button::None; id <= button::CairoElephant; ++id)
-					if (buttonStr[id] == bStr)
+				if (split != begin || !more)
+				{
+					window w;
+					try
 					{
-						button_ = static_cast<button>(id);
-						return;
+						w.actions_.parse(begin, split);
 					}
-			}
+					catch (const syntaxError& e)
+					{
+						throw script::relocate(e, lines, column);
+					}
+					w.last_ = !more;
+					if (!windows.push(w) || w.last_)
+						return;
 
-			button button_;
-			int x_, y_;
-		};
+					std::size_t newlines = static_cast<std::size_t>(std::count(begin, split, '\n'));
+					if (newlines)
+						column = static_cast<std::size_t>(split - std::find(std::reverse_iterator<const char*>(split), std::reverse_iterator<const char*>(begin), '\n').base());
+					else
+						column += static_cast<std::size_t>(split - begin);
+					lines += newlines;
+					buffer.erase(0, static_cast<std::size_t>(split - begin));
+				}
 
+				block = (std::min)(block * 2, window_);
+				more = fill(file, buffer, block);
+			}
+		}
 
-		class down : public base
+		void readBinary(std::FILE* file, std::string& buffer, bool more, queue& windows)
 		{
-		public:
-			down(const button& button, int x, int y)
-				: base(button, x, y) {}
-			down(const std::string& args)
+			if (buffer.size() < sizeof(binary::header))
+				throw std::runtime_error("Not a binary script.");
+			binary::header h;
+			std::copy(buffer.data(), buffer.data() + sizeof(h), reinterpret_cast<char*>(&h));
+			std::size_t prologue = sizeof(h) + static_cast<std::size_t>(binary::payload(static_cast<std::uint64_t>(h.opcodes_) * sizeof(binary::opcode))) * sizeof(binary::record);
+			if (h.opcodes_ > 256)
+				throw std::runtime_error("Binary script truncated.");
+			if (more && buffer.size() < prologue)
+				more = fill(file, buffer, prologue - buffer.size());
+
+			// checks the header and table...
+			std::string head = buffer.substr(0, prologue);
+			binary::image check(head.data(), head.size());
+
+			// ops carrying text are followed by payload...
+			bool text[256] = {};
+			const binary::opcode* table = reinterpret_cast<const binary::opcode*>(head.data() + sizeof(h));
+			for (std::uint32_t op = 0; op < h.opcodes_; ++op)
 			{
-				std::string bArgs;
-				std::istringstream iss(args);
-				iss >> bArgs >> std::ws >> x_ >> std::ws >> y_;
-				setButton(bArgs);
+				std::string name(table[op].name_, std::find(table[op].name_, table[op].name_ + sizeof(table[op].name_), '\0'));
+				for (unsigned int id = ID::Exec; id < ID::CairoElephant; ++id)
+					if (ID::str[id] == name)
+						text[op] = ID::text(id);
 			}
 
-			//std::string op() const { return ID::str[ID::MouseDown]; }
-			std::string op() const { return "md"; }
-
-			void inject() const
+			std::uint64_t remaining = h.records_ ? h.records_ : ~std::uint64_t(0);
+			buffer.erase(0, prologue);
+			std::size_t block = 4096;
+			for (;;)
 			{
-				std::vector<INPUT> input(2);
-				input[0].type = INPUT_MOUSE;
-				input[0].mi.dx = x_ * (65536 / GetSystemMetrics(SM_CXSCREEN));
-				input[0].mi.dy = y_ * (65536 / GetSystemMetrics(SM_CYSCREEN));
-				input[0].mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+				// whole actions only...
+				const binary::record* records = reinterpret_cast<const binary::record*>(buffer.data());
+				std::size_t count = static_cast<std::size_t>((std::min<std::uint64_t>)(buffer.size() / sizeof(binary::record), remaining));
+				std::size_t used = 0;
+				while (used < count)
+				{
+					std::size_t slots = 1 + (text[records[used].op_] ? static_cast<std::size_t>(binary::payload(static_cast<std::uint32_t>(records[used].a_))) : 0);
+					if (used + slots > count)
+						break;
+					used += slots;
+				}
+				remaining -= used;
 
-				input[1].type = INPUT_MOUSE;
-				switch (button_)
+				bool last = !more || !remaining;
+				if (used || last)
 				{
-				case button::Right:
-					input[1].mi.dwFlags = MOUSEEVENTF_RIGHTDOWN;
-					break;
-				case button::Left:
-					input[1].mi.dwFlags = MOUSEEVENTF_LEFTDOWN;
-					break;
-				case button::Middle:
-					input[1].mi.dwFlags = MOUSEEVENTF_MIDDLEDOWN;
-					break;
-				case button::X:
-					input[1].mi.dwFlags = MOUSEEVENTF_XDOWN;
-					break;
+					window w;
+					w.binary_ = head;
+					binary::header* wh = reinterpret_cast<binary::header*>(&w.binary_[0]);
+					wh->records_ = used;
+					w.binary_.append(buffer, 0, used * sizeof(binary::record));
+					w.last_ = last;
+					if (!windows.push(w) || last)
+						return;
+					buffer.erase(0, used * sizeof(binary::record));
 				}
 
-				SendInput(static_cast<UINT>(input.size()), &input.front(), sizeof(INPUT));
+				block = (std::min)(block * 2, window_);
+				more = fill(file, buffer, block);
+			}
+		}
+
+		std::string path_;
+		std::size_t window_;
+		std::uint64_t played_;
+		plan held_;		// bursts waiting to be sent, kept between plays
+	};
+
+	namespace record
+	{
+		// a raw input event as the hooks see it, the action it will become in binary form and when it happened...
+		struct event
+		{
+			binary::record action_;
+			std::int64_t time_;		// steady clock nanoseconds, see now()
+
+			static std::int64_t now()
+			{
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 			}
 		};
 
-		class up : public base
+		// how recorded mouse paths are thinned. Moves to where the cursor already is are dropped, then each run of
+		// moves is reduced to the fewest points that keep within tolerance pixels of the path. The last move before
+		// any other action is always kept, so clicks and wheels land where they did...
+		struct simplify
+		{
+			simplify()
+				: enabled_(false), tolerance_(2.0), window_(4096), idle_(250) {}
+
+			bool enabled_;
+			double tolerance_;
+			std::size_t window_;	// most moves held at once, longer runs are reduced a window at a time
+			unsigned int idle_;		// milliseconds without input after which held moves are written out
+		};
+
+		// keeps work out of the hook callbacks. Hooks push fixed size events into a lock free ring and return, a
+		// consumer thread turns them into actions and hands those to the listeners. The time between events becomes
+		// waits, rounded against the start of the recording so the rounding never adds up...
+		class pipeline
 		{
 		public:
-			up(const button& button, int x, int y)
-				: base(button, x, y) {}
-			up(const std::string& args)
+			explicit pipeline(std::size_t capacity = 1 << 16, const simplify& paths = simplify())
+				: ring_(capacity), paths_(paths), session_(0), running_(false), received_(0), moves_(0), removed_(0), origin_(0), elapsed_(0),
+				held_(false)
 			{
-				std::string bArgs;
-				std::istringstream iss(args);
-				iss >> bArgs >> std::ws >> x_ >> std::ws >> y_;
-				setButton(bArgs);
 			}
 
-			//std::string op() const { return ID::str[ID::MouseUp]; }
-			std::string op() const { return "mu"; }
+			~pipeline() { stop(); }
 
-			void inject() const
+			// called from the hooks, false if the ring was full and the event dropped...
+			bool push(const event& e)
 			{
-				std::vector<INPUT> input(2);
-				input[0].type = INPUT_MOUSE;
-				input[0].mi.dx = x_ * (65536 / GetSystemMetrics(SM_CXSCREEN));
-				input[0].mi.dy = y_ * (65536 / GetSystemMetrics(SM_CYSCREEN));
-				input[0].mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+				logger::write<logger::Debug>("record", e.action_, session_);
+				if (ring_.push(e))
+					return true;
+				logger::write<logger::Warning>("recording fell behind, event dropped", e.action_, session_);
+				return false;
+			}
 
-				input[1].type = INPUT_MOUSE;
-				switch (button_)
-				{
-				case button::Right:
-					input[1].mi.dwFlags = MOUSEEVENTF_RIGHTUP;
-					break;
-				case button::Left:
-					input[1].mi.dwFlags = MOUSEEVENTF_LEFTUP;
-					break;
-				case button::Middle:
-					input[1].mi.dwFlags = MOUSEEVENTF_MIDDLEUP;
-					break;
-				case button::X:
-					input[1].mi.dwFlags = MOUSEEVENTF_XUP;
-					break;
-				}
+			// the session logged against...
+			void tag(std::uint32_t session) { session_ = session; }
 
-				SendInput(static_cast<UINT>(input.size()), &input.front(), sizeof(INPUT));
+			void listen(ghost::script* s)
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				listeners_.push_back(s);
 			}
-		};
 
-		class wheel : public base
-		{
-			int value_;
-		public:
-			wheel(int value, int x, int y)
-				: base(button::None, x, y), value_(value) {}
-			wheel(const std::string& args)
+			void ignore(ghost::script* s)
 			{
-				std::istringstream iss(args);
-				iss >> value_ >> std::ws >> x_ >> std::ws >> y_;
+				std::lock_guard<std::mutex> lock(mutex_);
+				listeners_.remove(s);
 			}
 
-			//std::string op() const { return ID::str[ID::MouseWheel]; }
-			std::string op() const { return "mw"; }
-
-			void inject() const
+			// stream to a file rather than hold the recording...
+			void listen(binary::writer* w)
 			{
-				std::vector<INPUT> input(2);
-				input[0].type = INPUT_MOUSE;
-				input[0].mi.dx = x_ * (65536 / GetSystemMetrics(SM_CXSCREEN));
-				input[0].mi.dy = y_ * (65536 / GetSystemMetrics(SM_CYSCREEN));
-				input[0].mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+				std::lock_guard<std::mutex> lock(mutex_);
+				writers_.push_back(w);
+			}
 
-				input[1].type = INPUT_MOUSE;
-				input[1].mi.dwFlags = MOUSEEVENTF_WHEEL;
-				input[1].mi.mouseData = value_;
+			void ignore(binary::writer* w)
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				writers_.remove(w);
+			}
 
-				SendInput(static_cast<UINT>(input.size()), &input.front(), sizeof(INPUT));
+			// change how paths are simplified, only while stopped...
+			void configure(const simplify& paths) { paths_ = paths; }
 
+			void start()
+			{
+				if (running_.exchange(true))
+					return;
+				held_ = false;
+				origin_ = event::now();
+				elapsed_ = 0;
+				consumer_ = std::thread([this]() { consume(); });
 			}
-		};
 
-		class move : public base
-		{
-		public:
-			move(int x, int y)
-				: base(button::None, x, y) {}
-			move(const std::string& args)
+			// everything pushed before stop is delivered before it returns...
+			void stop()
 			{
-				std::istringstream iss(args);
-				iss >> x_ >> std::ws >> y_;
+				running_.store(false, std::memory_order_release);
+				if (consumer_.joinable())
+					consumer_.join();
 			}
 
-			//std::string op() const { return ID::str[ID::MouseMove]; }
-			std::string op() const { return "mm"; }
+			std::uint64_t received() const { return received_.load(std::memory_order_relaxed); }
+			std::uint64_t dropped() const { return ring_.dropped(); }
 
-			void inject() const
+			// mouse moves received, and those simplified away...
+			std::uint64_t moves() const { return moves_.load(std::memory_order_relaxed); }
+			std::uint64_t removed() const { return removed_.load(std::memory_order_relaxed); }
+
+		private:
+			void consume()
 			{
-				std::vector<INPUT> input(1);
-				input[0].type = INPUT_MOUSE;
-				input[0].mi.dx = x_ * (65536 / GetSystemMetrics(SM_CXSCREEN));
-				input[0].mi.dy = y_ * (65536 / GetSystemMetrics(SM_CYSCREEN));
-				input[0].mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+				for (;;)
+				{
+					bool stopping = !running_.load(std::memory_order_acquire);
+
+					std::uint64_t count = 0;
+					{
+						std::lock_guard<std::mutex> lock(mutex_);
+						event e;
+						while (ring_.pop(e))
+						{
+							deliver(e);
+							++count;
+						}
+					}
+					received_.fetch_add(count, std::memory_order_relaxed);
 
-				SendInput(static_cast<UINT>(input.size()), &input.front(), sizeof(INPUT));
+					if (!count)
+					{
+						// moves held with nothing following them...
+						if (!run_.empty() && (stopping || event::now() - run_.back().time_ > static_cast<std::int64_t>(paths_.idle_) * 1000000))
+						{
+							std::lock_guard<std::mutex> lock(mutex_);
+							reduce(true);
+						}
+
+						if (stopping)
+							return;
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}
+				}
 			}
-		};
 
-		static action factory(const std::string& op, const std::string& args)
-		{
-			action newAction;
+			void deliver(const event& e)
+			{
+				if (!paths_.enabled_)
+				{
+					emit(e);
+					return;
+				}
 
-			if (op == "mm")
-				newAction.reset(new move(args));
-			else if (op == "md")
-				newAction.reset(new down(args));
-			else if (op == "mu")
-				newAction.reset(new up(args));
-			else if (op == "mw")
-				newAction.reset(new wheel(args));
-			
-			return newAction;
-		}
+				if (e.action_.op_ != ID::MouseMove)
+				{
+					reduce(true);
+					emit(e);
+					return;
+				}
 
-	}	// namespace mouse
+				moves_.fetch_add(1, std::memory_order_relaxed);
 
+				// already there...
+				const binary::record* last = run_.empty() ? (held_ ? &previous_.action_ : nullptr) : &run_.back().action_;
+				if (last && last->a_ == e.action_.a_ && last->b_ == e.action_.b_)
+				{
+					removed_.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
 
-	namespace keyboard
-	{
-		// these are the special keys
-		enum key
-		{
-			None = 0,
-			Enter,
-			Cancel,
-			Backspace,
-			Tab,
-			Shift,
-			Control,
-			Alt,
-			Pause,
-			Capslock,
-			Escape,
-			Space,
-			PageUp,
-			PageDown,
-			End,
-			Home,
-			Left,
-			Right,
-			Up,
-			Down,
-			Select,
-			Print,
-			Insert,
-			Delete,
-			Help,
-			
+				run_.push_back(e);
+				if (run_.size() >= (std::max<std::size_t>)(paths_.window_, 3))
+					reduce(false);
+			}
 
-			CairoElephant
+			// Douglas-Peucker over the held moves, the last is kept back for the next window unless this is the end
+			// of the run...
+			void reduce(bool end)
+			{
+				if (run_.empty())
+					return;
 
-		};
+				std::vector<char> keep(run_.size(), 0);
+				keep.front() = keep.back() = 1;
 
-		struct keyCode
-		{
-			keyCode(const std::string& str, unsigned char key)
-				: str_(str), key_(key)
+				double tolerance = paths_.tolerance_ * paths_.tolerance_;
+				std::vector<std::pair<std::size_t, std::size_t> > spans(1, std::make_pair(std::size_t(0), run_.size() - 1));
+				while (!spans.empty())
+				{
+					std::size_t first = spans.back().first, last = spans.back().second;
+					spans.pop_back();
+
+					double furthest = 0.0;
+					std::size_t index = first;
+					for (std::size_t i = first + 1; i < last; ++i)
+					{
+						double d = distance(run_[i].action_, run_[first].action_, run_[last].action_);
+						if (d > furthest)
+						{
+							furthest = d;
+							index = i;
+						}
+					}
+					if (furthest > tolerance)
+					{
+						keep[index] = 1;
+						spans.push_back(std::make_pair(first, index));
+						spans.push_back(std::make_pair(index, last));
+					}
+				}
+
+				std::size_t kept = 0, count = end ? run_.size() : run_.size() - 1;
+				for (std::size_t i = 0; i < count; ++i)
+					if (keep[i])
+					{
+						emit(run_[i]);
+						++kept;
+					}
+				removed_.fetch_add(count - kept, std::memory_order_relaxed);
+
+				previous_ = run_.back();
+				held_ = true;
+				if (end)
+					run_.clear();
+				else
+					run_.erase(run_.begin(), run_.end() - 1);
+			}
+
+			// squared distance of p from the segment a to b...
+			static double distance(const binary::record& p, const binary::record& a, const binary::record& b)
 			{
+				double dx = static_cast<double>(b.a_) - a.a_, dy = static_cast<double>(b.b_) - a.b_;
+				double px = static_cast<double>(p.a_) - a.a_, py = static_cast<double>(p.b_) - a.b_;
+				double length = dx * dx + dy * dy;
+				double t = length > 0.0 ? (std::max)(0.0, (std::min)(1.0, (px * dx + py * dy) / length)) : 0.0;
+				px -= t * dx;
+				py -= t * dy;
+				return px * px + py * py;
 			}
 
-			std::string str_;
-			unsigned char key_;
-		};
+			void emit(const event& e)
+			{
+				auto f = [this](const auto& thisAction)
+				{
+					for (ghost::script* s : listeners_)
+						s->add(thisAction);
+					for (binary::writer* w : writers_)
+						w->add(thisAction);
+				};
+				// milliseconds since the start, to the nearest...
+				std::int64_t elapsed = (e.time_ - origin_ + 500000) / 1000000;
+				if (elapsed > elapsed_)
+				{
+					f(program::wait(static_cast<unsigned int>(elapsed - elapsed_)));
+					elapsed_ = elapsed;
+				}
 
-		static const std::vector<keyCode> special({
-			keyCode("", 0),
-			keyCode("Enter", VK_RETURN),
-			
-			keyCode("CairoElephant", 0)
-			});
+				binary::decode(e.action_, 0, e.action_.op_, f);
+			}
 
-		class base : public injectable
+			impl::ring<event> ring_;
+			simplify paths_;
+			std::uint32_t session_;
+			std::mutex mutex_;
+			std::list<ghost::script*> listeners_;
+			std::list<binary::writer*> writers_;
+			std::thread consumer_;
+			std::atomic<bool> running_;
+			std::atomic<std::uint64_t> received_;
+			std::atomic<std::uint64_t> moves_;
+			std::atomic<std::uint64_t> removed_;
+			std::int64_t origin_;
+			std::int64_t elapsed_;
+
+			// moves held for simplifying, and the last one written...
+			std::vector<event> run_;
+			event previous_;
+			bool held_;
+		};
+
+#ifdef GHOST_WINDOWS
+		namespace impl
 		{
-		public:
-			base(unsigned char k)
-				: key_(k) {}
-			base(const key& k)
-				: key_(special[k].key_) {}
+			// the pipelines of sessions recording, by the thread they hook. Hooks are called on the thread they
+			// hook and have no other context, so that is how they find where to push. Thread zero hooks every
+			// thread. Looking up takes no lock...
+			class hooks
+			{
+				struct slot
+				{
+					std::atomic<DWORD> thread_;
+					std::atomic<pipeline*> events_;
+				};
 
-			std::string args() const
+			public:
+				static const std::size_t capacity = 64;
+
+				static void add(DWORD thread, pipeline* events)
+				{
+					std::lock_guard<std::mutex> lock(mutex());
+					for (std::size_t i = 0; i < capacity; ++i)
+						if (!slots()[i].events_.load(std::memory_order_relaxed))
+						{
+							slots()[i].thread_.store(thread, std::memory_order_relaxed);
+							slots()[i].events_.store(events, std::memory_order_release);
+							return;
+						}
+					throw std::runtime_error("Too many sessions recording at once.");
+				}
+
+				static void remove(pipeline* events)
+				{
+					std::lock_guard<std::mutex> lock(mutex());
+					for (std::size_t i = 0; i < capacity; ++i)
+						if (slots()[i].events_.load(std::memory_order_relaxed) == events)
+							slots()[i].events_.store(nullptr, std::memory_order_release);
+				}
+
+				static pipeline* find(DWORD thread)
+				{
+					pipeline* any = nullptr;
+					for (std::size_t i = 0; i < capacity; ++i)
+						if (pipeline* events = slots()[i].events_.load(std::memory_order_acquire))
+						{
+							DWORD hooked = slots()[i].thread_.load(std::memory_order_relaxed);
+							if (hooked == thread)
+								return events;
+							if (!hooked)
+								any = events;
+						}
+					return any;
+				}
+
+			private:
+				static slot* slots()
+				{
+					static slot s[capacity] = {};
+					return s;
+				}
+				static std::mutex& mutex()
+				{
+					static std::mutex m;
+					return m;
+				}
+			};
+
+			inline void push(std::uint8_t op, std::uint8_t arg, std::int32_t a, std::int32_t b, std::int32_t c = 0)
 			{
-				return std::to_string(key_);
+				tracer::scope trace(ID::str[op].c_str(), "hook");
+				event e;
+				e.action_.op_ = op;
+				e.action_.arg_ = arg;
+				e.action_.reserved_ = 0;
+				e.action_.a_ = a;
+				e.action_.b_ = b;
+				e.action_.c_ = c;
+				e.time_ = event::now();
+				if (pipeline* events = hooks::find(GetCurrentThreadId()))
+					events->push(e);
 			}
 
-		protected:
-			unsigned char getKey(const std::string& keySyntax)
+			// the hook handle passed on is ignored, so the callbacks need not know which session they belong to...
+			static LRESULT MouseHookCallback(int nCode, WPARAM wParam, LPARAM lParam)
 			{
-				unsigned char result;
-				std::istringstream iss(keySyntax); iss >> result;
-				return result;
+				// If we support this event, the position comes with it so there is no need to ask for the cursor...
+				if (nCode >= 0)
+				{
+					const MOUSEHOOKSTRUCTEX* info = reinterpret_cast<const MOUSEHOOKSTRUCTEX*>(lParam);
+					LONG x = info->pt.x, y = info->pt.y;
+					if (wParam == WM_MOUSEMOVE)
+						push(ID::MouseMove, 0, x, y);
+					else if (wParam == WM_RBUTTONDOWN)
+						push(ID::MouseDown, mouse::button::Right, x, y);
+					else if (wParam == WM_LBUTTONDOWN)
+						push(ID::MouseDown, mouse::button::Left, x, y);
+					else if (wParam == WM_RBUTTONUP)
+						push(ID::MouseUp, mouse::button::Right, x, y);
+					else if (wParam == WM_LBUTTONUP)
+						push(ID::MouseUp, mouse::button::Left, x, y);
+					else if (wParam == WM_MBUTTONDOWN)
+						push(ID::MouseDown, mouse::button::Middle, x, y);
+					else if (wParam == WM_MBUTTONUP)
+						push(ID::MouseUp, mouse::button::Middle, x, y);
+					else if (wParam == WM_MOUSEWHEEL)
+						push(ID::MouseWheel, 0, GET_WHEEL_DELTA_WPARAM(info->mouseData), x, y);
+				}
+
+				return CallNextHookEx(NULL, nCode, wParam, lParam);
 			}
-			unsigned char key_;
+			static LRESULT KeyboardHookCallback(int nCode, WPARAM wParam, LPARAM lParam)
+			{
+				// wParam is the virtual key, bit 31 of lParam is set when it is released...
+				if (nCode >= 0)
+					push((lParam & 0x80000000) ? ID::KeyUp : ID::KeyDown, static_cast<std::uint8_t>(wParam), 0, 0);
+
+				return CallNextHookEx(NULL, nCode, wParam, lParam);
+			}
+		}
+#endif
+	}
+
+	// a target program and everything used to record and replay it. Each session has its own hooks, recording
+	// pipeline, listeners and backend, so any number of them can record and replay at once in one process. It can
+	// be used from any thread...
+	class session
+	{
+	public:
+		struct stats
+		{
+			std::uint64_t recorded_;	// events received from the hooks
+			std::uint64_t dropped_;		// events lost because recording fell behind
+			std::uint64_t moves_;		// mouse moves received
+			std::uint64_t removed_;		// and simplified away
+			std::uint64_t plays_;		// scripts played
+			std::uint64_t played_;		// actions played, steps for plans
 		};
 
+		explicit session(const program::exec& target = program::exec(""))
+			: id_(ids().fetch_add(1, std::memory_order_relaxed) + 1), target_(target), backend_(nullptr), started_(false), recording_(false),
+			pipeline_(nullptr), plays_(0), played_(0)
+#ifdef GHOST_WINDOWS
+			, mouseHook_(NULL), keyboardHook_(NULL)
+#endif
+		{
+		}
 
-		class down : public base
+		session(const program::exec& target, backend& b)
+			: session(target)
 		{
-		public:
-			down(unsigned char k) : base(k) {}
-			down(const key& k) : base(k) {}
-			down(const std::string& args)
-				: base(getKey(args))
-			{
-			}
+			backend_ = &b;
+		}
 
-			//std::string op() const { return ID::str[ID::KeyDown]; }
-			std::string op() const { return "kd"; }
+		~session()
+		{
+			stop();
+			target_.terminate();
+		}
 
-			void inject() const
-			{
-				byte vk = VkKeyScan((char)key_);
-				unsigned short scanCode = MapVirtualKey(vk, 0);
+		program::exec target() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return target_;
+		}
 
-				INPUT input;
-				input.type = INPUT_KEYBOARD;
-				input.ki.wScan = static_cast<unsigned short>(scanCode & 0xff);
-				input.ki.dwFlags = KEYEVENTF_SCANCODE;
+		// sessions are numbered from one, log entries carry the number...
+		std::uint32_t id() const { return id_; }
 
-				SendInput(1, &input, sizeof(INPUT));
-			}
-		};
+		// what is played to, the current backend of the playing thread if none is given...
+		void output(backend& b)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			backend_ = &b;
+		}
 
-		class up : public base
+		// where recorded actions go...
+		void listen(ghost::script* s) { events().listen(s); }
+		void ignore(ghost::script* s) { events().ignore(s); }
+		void listen(binary::writer* w) { events().listen(w); }
+		void ignore(binary::writer* w) { events().ignore(w); }
+
+		// start the target if it is not running, and record it until stop...
+		void start(const record::simplify& paths = record::simplify())
 		{
-		public:
-			up(unsigned char k) : base(k) {}
-			up(const key& k) : base(k) {}
-			up(const std::string& args)
-				: base(getKey(args))
-			{
-			}
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (recording_)
+				return;
+			launch();
+
+			record::pipeline& made = created();
+			made.configure(paths);
+			made.start();
+			logger::write<logger::Info>("recording started", logger::nothing(), id_);
+#ifdef GHOST_WINDOWS
+			record::impl::hooks::add(target_.threadID(), &made);
+			mouseHook_ = SetWindowsHookExW(WH_MOUSE, (HOOKPROC)record::impl::MouseHookCallback, (HINSTANCE)target_.handle(), target_.threadID());
+			keyboardHook_ = SetWindowsHookExW(WH_KEYBOARD, (HOOKPROC)record::impl::KeyboardHookCallback, (HINSTANCE)target_.handle(), target_.threadID());
+#endif
+			recording_ = true;
+		}
 
-			//std::string op() const { return ID::str[ID::KeyUp]; }
-			std::string op() const { return "ku"; }
+		// unhook, then let the pipeline catch up...
+		void stop()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!recording_)
+				return;
+#ifdef GHOST_WINDOWS
+			UnhookWindowsHookEx(mouseHook_);
+			UnhookWindowsHookEx(keyboardHook_);
+			record::impl::hooks::remove(events_.get());
+#endif
+			events_->stop();
+			recording_ = false;
+			logger::write<logger::Info>("recording stopped", logger::nothing(), id_);
+		}
 
-			void inject() const
-			{
-				byte vk = VkKeyScan((char)key_);
-				unsigned short scanCode = MapVirtualKey(vk, 0);
+		bool recording() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return recording_;
+		}
 
-				INPUT input;
-				input.type = INPUT_KEYBOARD;
-				input.ki.wScan = static_cast<unsigned short>(scanCode & 0xff); 
-				input.ki.dwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP;
+		// events from somewhere other than the hooks, as they would come from them. The ring has one producer, so
+		// push from one thread only, as the hooks do...
+		bool push(const record::event& e)
+		{
+			if (record::pipeline* made = pipeline_.load(std::memory_order_acquire))
+				return made->push(e);
+			return events().push(e);
+		}
 
-				SendInput(1, &input, sizeof(INPUT));
-			}
-		};
+		// record the target until it exits...
+		ghost::script record(const record::simplify& paths = record::simplify())
+		{
+			ghost::script result;
+			capture(result, paths);
+			return result;
+		}
 
-		class press : public base
+		// record the target straight to a binary file, which can be read while recording and is complete once
+		// this returns...
+		void record(const std::string& path, const record::simplify& paths = record::simplify())
 		{
-		public:
-			press(unsigned char k) : base(k) {}
-			press(const key& k) : base(k) {}
-			press(const std::string& args)
-				: base(getKey(args))
-			{
-			}
-			std::string op() const { return "kp"; }
+			binary::writer out(path);
+			capture(out, paths);
+			out.close();
+		}
 
-			void inject() const
-			{
-				keyboard::down(key_).inject();
-				program::wait(10).inject();
-				keyboard::up(key_).inject();
-			}
+		// replay to this session's backend, starting the target first if it is not running...
+		playStats play(ghost::script& s, const playback& options = playback())
+		{
+			logger::scope tag(id_);
+			logger::write<logger::Info>("play");
+			backend& b = prepare();
+			program::process::scope running(target().started());
+			playStats stats = s.play(b, options);
+			plays_.fetch_add(1, std::memory_order_relaxed);
+			played_.fetch_add(s.size(), std::memory_order_relaxed);
+			return stats;
+		}
 
-		};
+		playStats play(const plan& p, const playback& options = playback())
+		{
+			logger::scope tag(id_);
+			logger::write<logger::Info>("play");
+			backend& b = prepare();
+			program::process::scope running(target().started());
+			playStats stats = p.play(b, options);
+			plays_.fetch_add(1, std::memory_order_relaxed);
+			played_.fetch_add(p.steps().size(), std::memory_order_relaxed);
+			return stats;
+		}
 
-		class type : public base
+		playStats play(player& p, const playback& options = playback())
 		{
-			std::string str_;
-		public:
-			type(const std::string& str) : base(key::None), str_(str) {}
-			
-			std::string op() const { return "kt"; }
+			logger::scope tag(id_);
+			logger::write<logger::Info>("play");
+			backend& b = prepare();
+			program::process::scope running(target().started());
+			playStats stats = p.play(b, options);
+			plays_.fetch_add(1, std::memory_order_relaxed);
+			played_.fetch_add(p.size(), std::memory_order_relaxed);
+			return stats;
+		}
 
-			void inject() const
+		stats statistics() const
+		{
+			stats s = { 0, 0, 0, 0, plays_.load(std::memory_order_relaxed), played_.load(std::memory_order_relaxed) };
+			if (const record::pipeline* made = pipeline_.load(std::memory_order_acquire))
 			{
-				std::for_each(str_.begin(), str_.end(), [](char c) 
-				{
-					keyboard::press(c).inject();
-					program::wait w(20);
-				});
+				s.recorded_ = made->received();
+				s.dropped_ = made->dropped();
+				s.moves_ = made->moves();
+				s.removed_ = made->removed();
 			}
+			return s;
+		}
 
-		};
-
-		static action factory(const std::string& op, const std::string& args)
+	private:
+		void launch()
 		{
-			action newAction;
+			if (started_)
+				return;
+			target_.run();
+			started_ = true;
+		}
 
-			if (op == "ku")
-				newAction.reset(new up(args));
-			else if (op == "kd")
-				newAction.reset(new down(args));
-			else if (op == "kt")
-				newAction.reset(new press(args));
-			else if (op == "type")
-				newAction.reset(new type(args));
-			
-			return newAction;
+		backend& prepare()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			launch();
+			return backend_ ? *backend_ : backend::current();
 		}
 
-	}	// keyboard
+		template<typename L>
+		void capture(L& listener, const record::simplify& paths)
+		{
+			listener.add(target());
+			listen(&listener);
+			try
+			{
+				start(paths);
+				wait();
+				stop();
+			}
+			catch (...)
+			{
+				ignore(&listener);
+				throw;
+			}
+			ignore(&listener);
+		}
 
-	
-	class script
-	{
+		// until the target exits. Waiting is on a copy, so the target can be read meanwhile...
+		void wait()
+		{
+			program::exec running = target();
+			running.wait();
+			std::lock_guard<std::mutex> lock(mutex_);
+			target_ = running;
+		}
 
-		std::string rtrim(const std::string& str)
+		// the recording pipeline, only made once something is recorded as its ring is large...
+		record::pipeline& events()
 		{
-			std::size_t itr = str.find_last_not_of(' ');
-			return itr != std::string::npos ? str.substr(0, itr + 1) : str;
+			std::lock_guard<std::mutex> lock(mutex_);
+			return created();
 		}
-		std::string ltrim(const std::string& str)
+
+		record::pipeline& created()
 		{
-			std::size_t itr = str.find_first_not_of(' ');
-			return itr != std::string::npos ? str.substr(itr) : str;
+			if (!events_)
+			{
+				events_.reset(new record::pipeline());
+				events_->tag(id_);
+				pipeline_.store(events_.get(), std::memory_order_release);
+			}
+			return *events_;
 		}
-		std::string trim(const std::string& str)
+
+		static std::atomic<std::uint32_t>& ids()
 		{
-			return rtrim(ltrim(str));
+			static std::atomic<std::uint32_t> i(0);
+			return i;
 		}
-		std::string removeLineEnds(const std::string& str)
+
+		session(const session&);
+		session& operator=(const session&);
+
+		std::uint32_t id_;
+		mutable std::mutex mutex_;
+		program::exec target_;
+		backend* backend_;
+		bool started_;
+		bool recording_;
+		std::unique_ptr<record::pipeline> events_;
+		std::atomic<record::pipeline*> pipeline_;	// events_, for pushing without the lock
+		std::atomic<std::uint64_t> plays_;
+		std::atomic<std::uint64_t> played_;
+#ifdef GHOST_WINDOWS
+		HHOOK mouseHook_;
+		HHOOK keyboardHook_;
+#endif
+	};
+
+#ifdef GHOST_WINDOWS
+	namespace record
+	{
+		// record a program until it exits...
+		static ghost::script script(const program::exec& cmd, const simplify& paths = simplify())
 		{
-			std::string syntax = str;
-			syntax.erase(std::remove(syntax.begin(), syntax.end(), '\n'), syntax.end());
-			return syntax;
+			session s(cmd);
+			return s.record(paths);
 		}
 
-		action parseActionSyntax(const std::string& actionSyntax)
+		// record straight to a binary file, which can be read while recording and is complete once this returns...
+		static void stream(const program::exec& cmd, const std::string& path, const simplify& paths = simplify())
 		{
-			std::size_t argsStart = actionSyntax.find("{");
-			std::size_t argsEnd = actionSyntax.find("}");
+			session s(cmd);
+			s.record(path, paths);
+		}
+	}
+#endif
 
-			if (argsStart == std::string::npos || argsEnd == std::string::npos || argsStart > argsEnd)
-				throw std::exception("args syntax error.");
-			++argsStart;
-			std::string args = trim(actionSyntax.substr(argsStart, argsEnd - argsStart));
-			std::string op = trim(actionSyntax.substr(0, argsStart - 1));
+	inline void inject(const ghost::injectable& action)
+	{
+		if (logger::wants<logger::Debug>())
+			logger::instance().add(logger::Debug, "inject", logger::about(action), logger::current());
+		tracer* t = tracer::active();
+		tracer::span* s = t ? t->open(action.id() < ID::CairoElephant ? ID::str[action.id()].c_str() : "custom", "inject") : nullptr;
+		action.inject();
+		if (s)
+			t->close(s);
+	}
+}
 
-			action result = program::factory(op, args);
-			if (!result)
-				result = keyboard::factory(op, args);
-			if (!result)
-				result = mouse::factory(op, args);
-			if (!result)
-				throw std::exception("Unknown action syntax.");
+#if defined(GHOST_XTEST) && !defined(GHOST_WINDOWS)
+// X defines None, KeyPress and others as macros, so it comes after everything using those names...
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
 
-			return result;
-		}
+namespace ghost
+{
+	// sends to an X display through the XTest extension. Keys arrive as the characters they type, absolute moves
+	// are scaled to the screen of the display. A connection is for one thread...
+	class xtest : public backend
+	{
+		Display* display_;
+		int width_, height_;
 
-		std::list<action> actions_;
-		
 	public:
-
-		script(const std::string& scriptSyntax)
+		explicit xtest(const std::string& name = "")
+			: display_(XOpenDisplay(name.empty() ? nullptr : name.c_str())), width_(0), height_(0)
 		{
-			std::string str = removeLineEnds(scriptSyntax);
+			if (!display_)
+				throw std::runtime_error("Unable to open display " + name);
 
-			std::size_t start = 0;
-			std::size_t end = str.find(",");
-
-			while (end != std::string::npos)
+			int events, errors, major, minor;
+			if (!XTestQueryExtension(display_, &events, &errors, &major, &minor))
 			{
-				action newAction = parseActionSyntax(trim(str.substr(start, end - start)));
-				if (newAction)
-					actions_.push_back(newAction);
-
-				start = end + 1;
-				end = str.find(",", start);
+				XCloseDisplay(display_);
+				throw std::runtime_error("No XTest extension on display " + name);
 			}
-
-			// parse the last command token...
-			action lastAction = parseActionSyntax(trim(str.substr(start, end - (start))));
-			if (lastAction)
-				actions_.push_back(lastAction);
+			width_ = DisplayWidth(display_, DefaultScreen(display_));
+			height_ = DisplayHeight(display_, DefaultScreen(display_));
+			invalidate();
 		}
 
-		script()
+		~xtest()
 		{
+			XCloseDisplay(display_);
+			invalidate();
 		}
 
-		void play()
+		unsigned int send(const INPUT* inputs, unsigned int count)
 		{
-			// check first action is program::exec...
-			//if ( )
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				if (inputs[i].type == INPUT_MOUSE)
+					mouse(inputs[i].mi);
+				else if (inputs[i].type == INPUT_KEYBOARD)
+					key(inputs[i].ki);
+			}
+			XFlush(display_);
+			return count;
+		}
 
-			std::for_each(actions_.begin(), actions_.end(), [](action a) { a->inject(); });
+		int width() const { return width_; }
+		int height() const { return height_; }
 
-			// return when finished...
+		// titles as WM_NAME holds them, window managers put the window with the title anywhere below the root...
+		bool window(const char* title, bool focused) const
+		{
+			Window root = DefaultRootWindow(display_);
+			if (!focused)
+				return find(root, title);
+
+			// the focus may be on a child of the window with the title...
+			Window w = None;
+			int revert = 0;
+			XGetInputFocus(display_, &w, &revert);
+			for (; w != None && w != PointerRoot && w != root; w = parent(w))
+				if (named(w, title))
+					return true;
+			return false;
 		}
 
-		void wait()
+	private:
+		bool named(Window w, const char* title) const
 		{
-
+			char* name = nullptr;
+			bool match = XFetchName(display_, w, &name) && name && std::strcmp(name, title) == 0;
+			if (name)
+				XFree(name);
+			return match;
 		}
 
-		std::string syntax()
+		bool find(Window w, const char* title) const
 		{
-			std::ostringstream oss;
-			for (std::list<action>::const_iterator itr = actions_.begin(); itr != actions_.end(); ++itr)
-				oss << (*itr)->syntax() << ",";
-			return oss.str();
+			if (named(w, title))
+				return true;
+			Window root = None, parent = None;
+			Window* children = nullptr;
+			unsigned int count = 0;
+			if (!XQueryTree(display_, w, &root, &parent, &children, &count))
+				return false;
+			bool found = false;
+			for (unsigned int i = 0; i < count && !found; ++i)
+				found = find(children[i], title);
+			if (children)
+				XFree(children);
+			return found;
 		}
 
-		void add(action a)
+		Window parent(Window w) const
 		{
-			actions_.push_back(a);
+			Window root = None, parent = None;
+			Window* children = nullptr;
+			unsigned int count = 0;
+			if (XQueryTree(display_, w, &root, &parent, &children, &count) && children)
+				XFree(children);
+			return parent;
 		}
-	
-	};
 
-	namespace record
-	{
-		namespace impl
+		void mouse(const MOUSEINPUT& m)
 		{
-			static HHOOK mouseHookID_;
-			static HHOOK keyboardHookID_;
-			static std::list<ghost::script*> listeners_;
+			if (m.dwFlags & MOUSEEVENTF_MOVE)
+			{
+				// absolute coordinates are normalised to 0 - 65535...
+				if (m.dwFlags & MOUSEEVENTF_ABSOLUTE)
+					XTestFakeMotionEvent(display_, -1, ghost::mouse::screen::pixel(m.dx, width_), ghost::mouse::screen::pixel(m.dy, height_), CurrentTime);
+				else
+					XTestFakeRelativeMotionEvent(display_, m.dx, m.dy, CurrentTime);
+			}
 
-			static LRESULT MouseHookCallback(int nCode, WPARAM wParam, LPARAM lParam)
+			static const DWORD buttons[][2] = {
+				{ MOUSEEVENTF_LEFTDOWN, 1 }, { MOUSEEVENTF_LEFTUP, 1 },
+				{ MOUSEEVENTF_MIDDLEDOWN, 2 }, { MOUSEEVENTF_MIDDLEUP, 2 },
+				{ MOUSEEVENTF_RIGHTDOWN, 3 }, { MOUSEEVENTF_RIGHTUP, 3 } };
+			for (unsigned int b = 0; b < 6; ++b)
+				if (m.dwFlags & buttons[b][0])
+					XTestFakeButtonEvent(display_, buttons[b][1], b % 2 == 0, CurrentTime);
+
+			// the wheel is buttons 4 and 5, a click for each notch...
+			if (m.dwFlags & MOUSEEVENTF_WHEEL)
 			{
-				// If we support this event, 
-				if (nCode >= 0)
+				int delta = static_cast<int>(static_cast<LONG>(m.mouseData));
+				unsigned int button = delta > 0 ? 4 : 5;
+				for (int notch = (std::max)(1, std::abs(delta) / 120); notch > 0; --notch)
 				{
-					action thisAction;
-					POINT pt;
-					GetCursorPos(&pt);
-					if (wParam == WM_MOUSEMOVE)
-						thisAction.reset(new mouse::move(static_cast<unsigned int>(pt.x), static_cast<unsigned int>(pt.y)));
-					else if (wParam == WM_RBUTTONDOWN)
-						thisAction.reset(new mouse::down(mouse::button::Right, static_cast<unsigned int>(pt.x), static_cast<unsigned int>(pt.y)));
-					else if (wParam == WM_LBUTTONDOWN)
-						thisAction.reset(new mouse::down(mouse::button::Left, static_cast<unsigned int>(pt.x), static_cast<unsigned int>(pt.y)));
-					else if (wParam == WM_RBUTTONUP)
-						thisAction.reset(new mouse::up(mouse::button::Right, static_cast<unsigned int>(pt.x), static_cast<unsigned int>(pt.y)));
-					else if (wParam == WM_LBUTTONUP)
-						thisAction.reset(new mouse::up(mouse::button::Left, static_cast<unsigned int>(pt.x), static_cast<unsigned int>(pt.y)));
-					else if (wParam == WM_MBUTTONDOWN)
-						thisAction.reset(new mouse::down(mouse::button::Middle, static_cast<unsigned int>(pt.x), static_cast<unsigned int>(pt.y)));
-					else if (wParam == WM_MBUTTONUP)
-						thisAction.reset(new mouse::up(mouse::button::Middle, static_cast<unsigned int>(pt.x), static_cast<unsigned int>(pt.y)));
-					else if (wParam == WM_MOUSEWHEEL)
-						thisAction.reset(new mouse::wheel(0, static_cast<unsigned int>(pt.x), static_cast<unsigned int>(pt.y)));
+					XTestFakeButtonEvent(display_, button, True, CurrentTime);
+					XTestFakeButtonEvent(display_, button, False, CurrentTime);
+				}
+			}
+		}
 
-#ifdef GHOST_ENABLE_MESSAGES
-					if (ghost::messageCallback)
-						ghost::messageCallback("ghost hook: " + thisAction->syntax());
+		void key(const KEYBDINPUT& k)
+		{
+			// control characters are the low byte of their keysym, printable ones their own keysym...
+			unsigned int c = (k.dwFlags & (KEYEVENTF_SCANCODE | KEYEVENTF_UNICODE)) ? k.wScan : k.wVk;
+			KeySym sym = c < 0x20 || c == 0x7f ? 0xff00 | c : c < 0x100 ? c : 0x01000000 | c;
+			KeyCode code = XKeysymToKeycode(display_, sym);
+			if (!code)
+				return;
+
+			// characters on the shifted level of their key...
+			bool shift = XkbKeycodeToKeysym(display_, code, 0, 0) != sym;
+			KeyCode shiftCode = shift ? XKeysymToKeycode(display_, XK_Shift_L) : 0;
+			bool up = (k.dwFlags & KEYEVENTF_KEYUP) != 0;
+			if (shiftCode && !up)
+				XTestFakeKeyEvent(display_, shiftCode, True, CurrentTime);
+			XTestFakeKeyEvent(display_, code, !up, CurrentTime);
+			if (shiftCode && up)
+				XTestFakeKeyEvent(display_, shiftCode, False, CurrentTime);
+		}
+
+		xtest(const xtest&);
+		xtest& operator=(const xtest&);
+	};
+}
 #endif
 
-					if (thisAction)
-						std::for_each(listeners_.begin(), listeners_.end(), [&thisAction](ghost::script* s) { s->add(thisAction); });
+#ifndef GHOST_WINDOWS
+namespace ghost
+{
+	// runs many scripts at once, a worker for each core. Headless workers each start their own Xvfb display and
+	// run targets on it, so they cannot see each other's input. Scripts are shared out between the workers up front
+	// and a worker with nothing left takes from the back of another's queue...
+	class fleet
+	{
+	public:
+		// an Xvfb server, running until destroyed...
+		class display
+		{
+		public:
+			display(unsigned int number, int width = 1920, int height = 1080, const std::string& server = "Xvfb")
+				: name_(":" + std::to_string(number)),
+				server_(server + " " + name_ + " -screen 0 " + std::to_string(width) + "x" + std::to_string(height) + "x24 -nolisten tcp")
+			{
+				// a server answering already is someone else's, a socket left behind by one which has gone is not...
+				std::string socket = "/tmp/.X11-unix/X" + std::to_string(number);
+				if (answers(socket))
+					throw std::runtime_error("Display " + name_ + " is in use");
+				server_.run();
+
+				// ready once it answers on its socket, and is still ours...
+				for (unsigned int tries = 0; tries < 200 && server_.running(); ++tries)
+				{
+					if (answers(socket) && server_.running())
+						return;
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
 				}
+				server_.terminate();
+				throw std::runtime_error("Unable to start display " + name_);
+			}
+
+			~display() { server_.terminate(); }
+
+			const std::string& name() const { return name_; }
 
-				return CallNextHookEx(mouseHookID_, nCode, wParam, lParam);
+		private:
+			display(const display&);
+			display& operator=(const display&);
+
+			static bool answers(const std::string& socket)
+			{
+				sockaddr_un address = sockaddr_un();
+				address.sun_family = AF_UNIX;
+				if (socket.size() >= sizeof(address.sun_path))
+					return false;
+				std::memcpy(address.sun_path, socket.c_str(), socket.size() + 1);
+				int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+				if (fd < 0)
+					return false;
+				bool connected = !::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+				::close(fd);
+				return connected;
 			}
-			static LRESULT KeyboardHookCallback(int nCode, WPARAM wParam, LPARAM lParam)
+
+			std::string name_;
+			program::exec server_;
+		};
+
+		struct options
+		{
+			options()
+				: workers_(0), headless_(true), first_(99), width_(1920), height_(1080), server_("Xvfb") {}
+
+			unsigned int workers_;		// zero for one per core
+			bool headless_;				// a display for each worker, otherwise targets use the current one
+			unsigned int first_;		// number of the first worker's display
+			int width_, height_;
+			std::string server_;
+			playback playback_;
+		};
+
+		struct result
+		{
+			std::string name_;
+			unsigned int worker_;
+			std::string display_;
+			bool passed_;
+			std::string error_;
+			double seconds_;
+			std::uint64_t actions_;
+		};
+
+		struct summary
+		{
+			std::vector<result> results_;	// in the order added
+			unsigned int workers_;
+			double seconds_;				// from start to finish
+
+			std::size_t passed() const
 			{
-				if (nCode >= 0)
-				{
-					action thisAction;
-					if (wParam == WM_KEYDOWN)
-						thisAction.reset(new keyboard::down(static_cast<unsigned char>(lParam)));
-					else if (wParam == WM_KEYUP)
-						thisAction.reset(new keyboard::up(static_cast<unsigned char>(lParam)));
+				return static_cast<std::size_t>(std::count_if(results_.begin(), results_.end(), [](const result& r) { return r.passed_; }));
+			}
+			std::size_t failed() const { return results_.size() - passed(); }
 
-#ifdef GHOST_ENABLE_MESSAGES
-					if (ghost::messageCallback)
-						ghost::messageCallback("ghost hook: " + thisAction->syntax());
-#endif
+			// time spent playing, across every worker...
+			double busy() const
+			{
+				double total = 0.0;
+				for (std::vector<result>::const_iterator itr = results_.begin(); itr != results_.end(); ++itr)
+					total += itr->seconds_;
+				return total;
+			}
 
-					if (thisAction)
-						std::for_each(listeners_.begin(), listeners_.end(), [&thisAction](ghost::script* s) { s->add(thisAction); });
+			std::string report() const
+			{
+				std::ostringstream oss;
+				for (std::vector<result>::const_iterator itr = results_.begin(); itr != results_.end(); ++itr)
+				{
+					oss << (itr->passed_ ? "pass " : "FAIL ") << itr->name_ << " worker " << itr->worker_;
+					if (!itr->display_.empty())
+						oss << " display " << itr->display_;
+					oss << " " << itr->seconds_ << "s " << itr->actions_ << " actions";
+					if (!itr->passed_)
+						oss << ", " << itr->error_;
+					oss << "\n";
 				}
-				
-				return CallNextHookEx(keyboardHookID_, nCode, wParam, lParam);
+				oss << passed() << " passed, " << failed() << " failed, " << seconds_ << "s on " << workers_ << " workers, " << busy() << "s busy\n";
+				return oss.str();
 			}
-		}
+		};
 
-		static ghost::script script(const program::exec& cmd)
+		explicit fleet(const options& o = options())
+			: options_(o)
 		{
-			ghost::script result;
-			action thisProgram(new program::exec(cmd.args()));
-			program::exec& prog = static_cast<program::exec&>(*thisProgram);
-
-			result.add(thisProgram);
-
-			prog.run();
+		}
 
-			impl::listeners_.push_back(&result);
+		// the script is copied, its leading exec is the target...
+		void add(const std::string& name, const ghost::script& s)
+		{
+			job j = { name, std::make_shared<ghost::script>(s) };
+			jobs_.push_back(j);
+		}
 
-			impl::mouseHookID_ = SetWindowsHookExW(WH_MOUSE, (HOOKPROC)impl::MouseHookCallback, (HINSTANCE)prog.handle(), prog.threadID());
-			impl::keyboardHookID_ = SetWindowsHookExW(WH_KEYBOARD, (HOOKPROC)impl::KeyboardHookCallback, (HINSTANCE)prog.handle(), prog.threadID());
+		std::size_t size() const { return jobs_.size(); }
 
-			prog.wait();
-			
-			std::list<ghost::script*>::iterator itr = std::find(impl::listeners_.begin(), impl::listeners_.end(), &result);
-			if (itr != impl::listeners_.end())
-				impl::listeners_.erase(itr);
-			
-			// unhook the callbacks...
-			UnhookWindowsHookEx(impl::mouseHookID_);
-			UnhookWindowsHookEx(impl::keyboardHookID_);
+		// play everything added and wait for it...
+		summary run()
+		{
+			unsigned int workers = options_.workers_ ? options_.workers_ : (std::max)(1u, std::thread::hardware_concurrency());
+			workers = static_cast<unsigned int>((std::min<std::size_t>)(workers, (std::max<std::size_t>)(jobs_.size(), 1)));
+
+			summary result;
+			result.workers_ = workers;
+			result.results_.resize(jobs_.size());
+
+			std::vector<std::unique_ptr<display> > displays;
+			if (options_.headless_)
+				for (unsigned int w = 0; w < workers; ++w)
+					displays.push_back(std::unique_ptr<display>(new display(options_.first_ + w, options_.width_, options_.height_, options_.server_)));
+
+			std::vector<std::unique_ptr<queue> > queues;
+			for (unsigned int w = 0; w < workers; ++w)
+				queues.push_back(std::unique_ptr<queue>(new queue()));
+			for (std::size_t j = 0; j < jobs_.size(); ++j)
+				queues[j % workers]->jobs_.push_back(j);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::vector<std::thread> threads;
+			for (unsigned int w = 0; w < workers; ++w)
+				threads.push_back(std::thread([&, w]() { work(w, displays.empty() ? std::string() : displays[w]->name(), queues, result.results_); }));
+			std::for_each(threads.begin(), threads.end(), [](std::thread& t) { t.join(); });
+			result.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
 			return result;
 		}
 
+	private:
+		struct job
+		{
+			std::string name_;
+			std::shared_ptr<ghost::script> script_;
+		};
 
+		struct queue
+		{
+			std::mutex mutex_;
+			std::deque<std::size_t> jobs_;
+		};
 
-	}
+		// the next job from the front of our own queue, or the back of someone else's...
+		static bool take(unsigned int worker, std::vector<std::unique_ptr<queue> >& queues, std::size_t& j)
+		{
+			for (std::size_t i = 0; i < queues.size(); ++i)
+			{
+				queue& q = *queues[(worker + i) % queues.size()];
+				std::lock_guard<std::mutex> lock(q.mutex_);
+				if (q.jobs_.empty())
+					continue;
+				if (i == 0)
+				{
+					j = q.jobs_.front();
+					q.jobs_.pop_front();
+				}
+				else
+				{
+					j = q.jobs_.back();
+					q.jobs_.pop_back();
+				}
+				return true;
+			}
+			return false;
+		}
 
-	static void inject(const ghost::injectable& action)
-	{
-#ifdef GHOST_ENABLE_MESSAGES
-		if (ghost::messageCallback)
-			ghost::messageCallback("ghost inject: " + action.syntax());
+		void work(unsigned int worker, const std::string& name, std::vector<std::unique_ptr<queue> >& queues, std::vector<result>& results)
+		{
+#ifdef GHOST_XTEST
+			std::unique_ptr<backend> output;
+			if (!name.empty())
+				output.reset(new xtest(name));
+			else
+				output.reset(new loopback(0, options_.width_, options_.height_));
+#else
+			// without XTest input goes nowhere, which still runs the targets and times the scripts...
+			std::unique_ptr<backend> output(new loopback(0, options_.width_, options_.height_));
 #endif
-		action.inject();
-	}
+
+			std::size_t j;
+			while (take(worker, queues, j))
+			{
+				const job& thisJob = jobs_[j];
+				result& r = results[j];
+				r.name_ = thisJob.name_;
+				r.worker_ = worker;
+				r.display_ = name;
+				r.actions_ = thisJob.script_->size();
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				try
+				{
+					program::exec target("");
+					thisJob.script_->front([&target](const injectable& a)
+					{
+						if (a.id() == ID::Exec)
+							target = program::exec(a.args());
+					});
+					target.display(name);
+
+					session s(target, *output);
+					s.play(*thisJob.script_, options_.playback_);
+					r.passed_ = true;
+				}
+				catch (const std::exception& e)
+				{
+					r.passed_ = false;
+					r.error_ = e.what();
+				}
+				r.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+		}
+
+		options options_;
+		std::vector<job> jobs_;
+	};
 }
+#endif
 
 #endif // GHOST_HPP
\ No newline at end of file
@@ -0,0 +1,18 @@
+// A fixed script checked at compile time. Built as it is, the script is valid and this compiles. Built with
+// GHOST_INVALID, a wait is negative and it must not, ctest expects that build to fail...
+
+#include "../include/ghost.hpp"
+
+#ifdef GHOST_INVALID
+#define GHOST_PAUSE -1
+#else
+#define GHOST_PAUSE 1
+#endif
+
+constexpr auto macro = ghost::fixed::script(ghost::fixed::exec("cmd"), ghost::fixed::wait(GHOST_PAUSE), ghost::fixed::press('e'));
+static_assert(macro.size() == 3, "a fixed script has a step for each it is given");
+
+int main()
+{
+	return 0;
+}
@@ -0,0 +1,839 @@
+// Behaviour tests, run by ctest. Each test is named on the command line and fails by throwing, nothing is sent
+// anywhere, replays go to a loopback backend...
+//
+//	ghost_tests name
+
+#include "../include/ghost.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+	void expect(bool ok, const std::string& what)
+	{
+		if (!ok)
+			throw std::runtime_error(what);
+	}
+
+	template<typename T, typename U>
+	void expectEqual(const T& actual, const U& expected, const std::string& what)
+	{
+		if (!(actual == expected))
+		{
+			std::ostringstream oss;
+			oss << what << ", expected " << expected << " but was " << actual;
+			throw std::runtime_error(oss.str());
+		}
+	}
+
+	// a file in the directory the test runs in, removed however the test ends...
+	struct temporary
+	{
+		explicit temporary(const std::string& name)
+			: path_("ghost_tests_" + name) {}
+		~temporary() { std::remove(path_.c_str()); }
+
+		std::string path_;
+	};
+
+	// every kind of action, with commas in the text of those which take text...
+	const char* every = "exec {notepad},w {250},mm {10 20},md {mr 10 20},mu {mr 10 20},mw {-120 10 20},kd {97},ku {97},"
+		"kp {13},kt {a,b},kx {50,one, two},wi {1000},ww {2000,Save, As},wf {3000,Save As},wu {4000,ready},";
+
+	// moves, clicks, keys and text with no waits, so replays do not sleep...
+	ghost::script generate(std::size_t actions)
+	{
+		ghost::script result;
+		for (std::size_t i = 0; i < actions; ++i)
+		{
+			int x = static_cast<int>(i * 7 % 1920), y = static_cast<int>(i * 13 % 1080);
+			switch (i % 8)
+			{
+			case 3:
+				result.add(ghost::mouse::down(ghost::mouse::button::Left, x, y));
+				break;
+			case 4:
+				result.add(ghost::mouse::up(ghost::mouse::button::Left, x, y));
+				break;
+			case 5:
+				result.add(ghost::keyboard::down(static_cast<unsigned char>('a' + i % 26)));
+				break;
+			case 6:
+				result.add(ghost::keyboard::up(static_cast<unsigned char>('a' + i % 26)));
+				break;
+			case 7:
+				result.add(ghost::keyboard::text(i % 3 ? "x, y" : "\xc3\xa9t\xc3\xa9"));
+				break;
+			default:
+				result.add(ghost::mouse::move(x, y));
+			}
+		}
+		return result;
+	}
+
+	bool same(const ghost::INPUT& a, const ghost::INPUT& b)
+	{
+		if (a.type != b.type)
+			return false;
+		if (a.type == ghost::INPUT_KEYBOARD)
+			return a.ki.wVk == b.ki.wVk && a.ki.wScan == b.ki.wScan && a.ki.dwFlags == b.ki.dwFlags;
+		return a.mi.dx == b.mi.dx && a.mi.dy == b.mi.dy && a.mi.mouseData == b.mi.mouseData && a.mi.dwFlags == b.mi.dwFlags;
+	}
+
+	void same(const ghost::loopback& a, const ghost::loopback& b, const std::string& what)
+	{
+		expectEqual(a.inputs(), b.inputs(), what + ", records sent");
+		std::vector<ghost::INPUT> x = a.recent(), y = b.recent();
+		for (std::size_t i = 0; i < x.size(); ++i)
+			expect(same(x[i], y[i]), what + ", record " + std::to_string(i) + " differs");
+	}
+
+	std::string read(const std::string& path)
+	{
+		std::string result;
+		if (std::FILE* file = std::fopen(path.c_str(), "rb"))
+		{
+			char buffer[4096];
+			std::size_t n;
+			while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+				result.append(buffer, n);
+			std::fclose(file);
+		}
+		return result;
+	}
+
+	// text to a script and back gives the same text, as does building the script in code...
+	void syntaxRoundTrip()
+	{
+		ghost::script parsed(every);
+		expectEqual(parsed.size(), 15u, "actions parsed");
+		expectEqual(parsed.syntax(), std::string(every), "syntax of the parsed script");
+
+		ghost::script built;
+		built.add(ghost::keyboard::text("hello, world", 0));
+		built.add(ghost::program::window("Open, Save", 100));
+		built.add(ghost::keyboard::type("1,2,3"));
+		ghost::script again(built.syntax());
+		expectEqual(again.syntax(), built.syntax(), "syntax of the reparsed script");
+		expectEqual(again.binary(), built.binary(), "records of the reparsed script");
+
+		temporary file("roundtrip.txt");
+		parsed.save(file.path_);
+		expectEqual(read(file.path_), std::string(every), "saved syntax");
+	}
+
+	// a large script split across threads parses to the same records as on one thread...
+	void syntaxParallel()
+	{
+		std::string text = generate(100000).syntax();
+		ghost::script serial(text);
+		ghost::script parallel(text, 4);
+		expectEqual(parallel.size(), serial.size(), "actions parsed");
+		expect(parallel.binary() == serial.binary(), "records differ from those parsed on one thread");
+
+		// an error late in the text is placed as it would be on one thread...
+		std::string bad = text + "\nmm {1 x},";
+		std::size_t line = 0, column = 0;
+		try
+		{
+			ghost::script s(bad, 4);
+		}
+		catch (const ghost::syntaxError& e)
+		{
+			line = e.line();
+			column = e.column();
+		}
+		expectEqual(line, 2u, "line of the error");
+		expectEqual(column, 7u, "column of the error");
+	}
+
+	void syntaxErrors()
+	{
+		struct
+		{
+			const char* text_;
+			std::size_t line_, column_;
+		} cases[] =
+		{
+			{ "mm {1 x},", 1, 7 },
+			{ "mm {1 2},\nkd {97},\nzz {1},", 3, 1 },
+			{ "mm {1 2},\r\n  mm {1 2 3},", 2, 11 },
+			{ "kx {0,text", 1, 7 },
+		};
+		for (const auto& c : cases)
+		{
+			bool thrown = false;
+			try
+			{
+				ghost::script s(c.text_);
+			}
+			catch (const ghost::syntaxError& e)
+			{
+				thrown = true;
+				expectEqual(e.line(), c.line_, std::string("line of the error in ") + c.text_);
+				expectEqual(e.column(), c.column_, std::string("column of the error in ") + c.text_);
+			}
+			expect(thrown, std::string("no error in ") + c.text_);
+		}
+	}
+
+	// a script through the binary format and back, from memory and from a file...
+	void binaryRoundTrip()
+	{
+		ghost::script s(every);
+		std::string bytes = s.binary();
+
+		ghost::binary::image image(bytes.data(), bytes.size());
+		expectEqual(image.syntax(), std::string(every), "syntax of the image");
+		expectEqual(image.script().binary(), bytes, "records of the image's script");
+
+		temporary file("roundtrip.ghost");
+		{
+			std::FILE* f = std::fopen(file.path_.c_str(), "wb");
+			expect(f && std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size(), "unable to write " + file.path_);
+			std::fclose(f);
+		}
+		ghost::binary::image mapped(file.path_);
+		expectEqual(mapped.size(), image.size(), "records in the mapped image");
+		expectEqual(mapped.syntax(), std::string(every), "syntax of the mapped image");
+	}
+
+	// the same records reach the backend however a script is replayed...
+	void replay()
+	{
+		ghost::script s = generate(5000);
+		ghost::loopback expected(1 << 16);
+		s.play(expected);
+
+		ghost::loopback compiled(1 << 16);
+		s.compile().play(compiled);
+		same(compiled, expected, "compiled plan");
+
+		std::string bytes = s.binary();
+		ghost::loopback image(1 << 16);
+		ghost::binary::image(bytes.data(), bytes.size()).play(image);
+		same(image, expected, "image");
+
+		// bursts send the same records in fewer submissions. A script keeps the plan its first burst compiles,
+		// an image batches as it is walked and may cut a burst short where a batch ends...
+		ghost::playback burst;
+		burst.burst_ = 64;
+		ghost::loopback batched(1 << 16), again(1 << 16), planned(1 << 16), imageBatched(1 << 16);
+		s.play(batched, burst);
+		s.play(again, burst);
+		s.compile().play(planned, burst);
+		ghost::binary::image(bytes.data(), bytes.size()).play(imageBatched, burst);
+		same(batched, expected, "burst");
+		same(again, expected, "second burst");
+		same(imageBatched, expected, "image burst");
+		expect(batched.sends() < expected.sends(), "bursts were not batched");
+		expectEqual(batched.sends(), planned.sends(), "burst submissions");
+		expectEqual(again.sends(), planned.sends(), "second burst submissions");
+		expect(imageBatched.sends() <= planned.sends() + planned.inputs() / 4096 + 1, "image bursts were cut short too often");
+
+		// a script which changes compiles again...
+		s.add(ghost::mouse::move(1, 1));
+		ghost::loopback changed(1 << 16);
+		s.play(changed, burst);
+		expectEqual(changed.inputs(), expected.inputs() + 1, "records sent once the script changed");
+	}
+
+	// a file played a window at a time sends what the script in memory does, text or binary...
+	void player()
+	{
+		ghost::script s = generate(20000);
+		ghost::loopback expected(1 << 16);
+		s.play(expected);
+
+		temporary text("player.txt");
+		s.save(text.path_);
+		ghost::player fromText(text.path_, 4096);
+		ghost::loopback played(1 << 16);
+		fromText.play(played);
+		expectEqual(fromText.size(), s.size(), "actions played from text");
+		same(played, expected, "played from text");
+
+		temporary binary("player.ghost");
+		{
+			std::string bytes = s.binary();
+			std::FILE* f = std::fopen(binary.path_.c_str(), "wb");
+			expect(f && std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size(), "unable to write " + binary.path_);
+			std::fclose(f);
+		}
+		ghost::player fromBinary(binary.path_, 4096);
+		ghost::loopback playedBinary(1 << 16);
+		ghost::playback burst;
+		burst.burst_ = 64;
+		fromBinary.play(playedBinary, burst);
+		expectEqual(fromBinary.size(), s.size(), "actions played from binary");
+		same(playedBinary, expected, "played from binary");
+	}
+
+	// a file being written can be mapped and read up to the last flush, and is complete once closed...
+	void writerLive()
+	{
+		temporary file("live.ghost");
+		ghost::binary::writer w(file.path_, 64);
+		ghost::script first("mm {1 2},kx {0,a, b},md {ml 1 2},");
+		first.visit([&w](const ghost::injectable& a) { w.add(a); });
+		w.flush();
+		{
+			ghost::binary::image live(file.path_);
+			expectEqual(live.size(), w.size(), "records readable while writing");
+			expectEqual(live.syntax(), first.syntax(), "syntax readable while writing");
+		}
+
+		w.add(ghost::mouse::up(ghost::mouse::button::Left, 1, 2));
+		w.close();
+		ghost::binary::image closed(file.path_);
+		expectEqual(closed.info().records_, w.size(), "records counted on close");
+		expectEqual(closed.syntax(), first.syntax() + "mu {ml 1 2},", "syntax once closed");
+
+		w.add(ghost::mouse::move(0, 0));
+		expectEqual(w.dropped(), 1u, "actions dropped after close");
+	}
+
+	// moves along an L simplify to its ends and corner, repeats are dropped...
+	void simplify()
+	{
+		ghost::record::simplify paths;
+		paths.enabled_ = true;
+		ghost::record::pipeline p(1 << 10, paths);
+		ghost::script recorded;
+		p.listen(&recorded);
+		p.start();
+
+		std::int64_t now = ghost::record::event::now();
+		auto push = [&p, now](const ghost::injectable& a)
+		{
+			ghost::binary::record r = {};
+			std::string text;
+			a.encode(r, text);
+			ghost::record::event e = { r, now };
+			expect(p.push(e), "event dropped");
+		};
+		for (int x = 0; x <= 50; ++x)
+			push(ghost::mouse::move(x, 0));
+		push(ghost::mouse::move(50, 0));
+		for (int y = 1; y <= 50; ++y)
+			push(ghost::mouse::move(50, y));
+		push(ghost::keyboard::down('a'));
+		p.stop();
+
+		expectEqual(p.received(), 103u, "events received");
+		expectEqual(p.moves(), 102u, "moves received");
+		expectEqual(p.removed(), 99u, "moves removed");
+
+		std::string kept;
+		recorded.visit([&kept](const ghost::injectable& a)
+		{
+			if (a.id() != ghost::ID::Wait)
+				kept += a.op() + " {" + a.args() + "},";
+		});
+		expectEqual(kept, std::string("mm {0 0},mm {50 0},mm {50 50},kd {97},"), "actions recorded");
+	}
+
+	// utf-8 to a down and up for each utf-16 unit, anything invalid as the replacement character...
+	void keyboardText()
+	{
+		struct
+		{
+			const char* text_;
+			std::vector<ghost::WORD> units_;
+		} cases[] =
+		{
+			{ "a\xc3\xa9", { 'a', 0xe9 } },
+			{ "\xf0\x9f\x98\x80", { 0xd83d, 0xde00 } },
+			{ "a\xff" "b", { 'a', 0xfffd, 'b' } },
+			{ "\x80", { 0xfffd } },
+			{ "\xc0\xaf", { 0xfffd } },
+			{ "\xed\xa0\x80", { 0xfffd } },
+			{ "\xf4\x90\x80\x80", { 0xfffd } },
+			{ "\xe2\x82", { 0xfffd, 0xfffd } },
+			{ "\xe2(a", { 0xfffd, '(', 'a' } },
+		};
+		for (const auto& c : cases)
+		{
+			ghost::plan p;
+			p.lower(ghost::keyboard::text(c.text_));
+			const std::vector<ghost::INPUT>& inputs = p.inputs();
+			expectEqual(inputs.size(), c.units_.size() * 2, "records for a text");
+			for (std::size_t i = 0; i < inputs.size(); ++i)
+			{
+				const ghost::INPUT& in = inputs[i];
+				expect(in.type == ghost::INPUT_KEYBOARD && (in.ki.dwFlags & ghost::KEYEVENTF_UNICODE), "not a unicode key");
+				expectEqual(in.ki.wScan, c.units_[i / 2], "unit " + std::to_string(i / 2));
+				expectEqual((in.ki.dwFlags & ghost::KEYEVENTF_KEYUP) != 0, i % 2 == 1, "down then up");
+			}
+		}
+	}
+
+	// every pixel to absolute coordinates and back lands where it started, on sizes which divide 65536 and those
+	// which do not...
+	void mouseScreen()
+	{
+		for (int size : { 640, 768, 1024, 1080, 1366, 1920, 2048, 2160, 3840, 4096, 7680 })
+		{
+			ghost::loopback b(0, size, size);
+			ghost::mouse::screen scn(b);
+			for (int p = 0; p < size; ++p)
+			{
+				expectEqual(ghost::mouse::screen::pixel(scn.absoluteX(p), size), p, "x on " + std::to_string(size));
+				expectEqual(ghost::mouse::screen::pixel(scn.absoluteY(p), size), p, "y on " + std::to_string(size));
+			}
+		}
+	}
+
+	// scripts shared across workers without displays, each result where it was added. There are no fleets on
+	// Windows...
+	void fleet()
+	{
+#ifndef GHOST_WINDOWS
+		ghost::fleet::options o;
+		o.workers_ = 3;
+		o.headless_ = false;
+		ghost::fleet f(o);
+		for (int i = 0; i < 8; ++i)
+			f.add("passes " + std::to_string(i), ghost::script("exec {true},mm {1 2},kd {97},ku {97},"));
+		f.add("times out", ghost::script("exec {true},wu {20,never defined},"));
+
+		ghost::fleet::summary s = f.run();
+		expectEqual(s.workers_, 3u, "workers");
+		expectEqual(s.results_.size(), 9u, "results");
+		expectEqual(s.passed(), 8u, "passed");
+		expectEqual(s.failed(), 1u, "failed");
+		for (int i = 0; i < 8; ++i)
+		{
+			expectEqual(s.results_[i].name_, "passes " + std::to_string(i), "result order");
+			expectEqual(s.results_[i].actions_, 4u, "actions");
+			expect(s.results_[i].worker_ < 3, "worker out of range");
+		}
+		expect(!s.results_[8].passed_ && !s.results_[8].error_.empty(), "a failing script passed");
+#endif
+	}
+
+	// a session which only plays, and one recording events pushed as the hooks would push them while its target
+	// runs...
+	void session()
+	{
+		ghost::loopback out(1 << 10);
+		ghost::session playing(ghost::program::exec(""), out);
+		ghost::script s("mm {1 2},kd {97},ku {97},");
+		playing.play(s);
+		playing.play(s);
+		ghost::session::stats played = playing.statistics();
+		expectEqual(played.plays_, 2u, "plays");
+		expectEqual(played.played_, 6u, "actions played");
+		expectEqual(played.recorded_, 0u, "events recorded by a session which only plays");
+		expectEqual(out.inputs(), 6u, "records sent");
+
+#ifndef GHOST_WINDOWS
+		ghost::session recording(ghost::program::exec("sleep 0.2"));
+		std::atomic<bool> done(false);
+		bool target = true;
+		std::thread hooks([&]()
+		{
+			auto push = [&recording](const ghost::injectable& a)
+			{
+				ghost::binary::record r = {};
+				std::string text;
+				a.encode(r, text);
+				ghost::record::event e = { r, ghost::record::event::now() };
+				recording.push(e);
+			};
+			for (int i = 0; i < 10; ++i)
+				push(ghost::mouse::move(i, i));
+			push(ghost::keyboard::down('a'));
+
+			// the target is read while the recording waits for it to exit...
+			while (!done.load())
+				target = target && recording.target().args() == "sleep 0.2";
+		});
+		ghost::script recorded = recording.record();
+		done.store(true);
+		hooks.join();
+		expect(target, "target changed while recording");
+
+		std::string kept;
+		recorded.visit([&kept](const ghost::injectable& a)
+		{
+			if (a.id() != ghost::ID::Wait)
+				kept += a.op() + ",";
+		});
+		expectEqual(kept, std::string("exec,mm,mm,mm,mm,mm,mm,mm,mm,mm,mm,kd,"), "actions recorded");
+		expectEqual(recording.statistics().recorded_, 11u, "events recorded");
+		expect(!recording.recording(), "still recording once the target exited");
+#endif
+	}
+
+	// a fixed script plays the records its script would, bursts included...
+	void fixedScript()
+	{
+		constexpr auto macro = ghost::fixed::script(
+			ghost::fixed::exec("cmd"),
+			ghost::fixed::move(10, 20),
+			ghost::fixed::down(ghost::mouse::Left, 10, 20),
+			ghost::fixed::up(ghost::mouse::Left, 12, 22),
+			ghost::fixed::wait(0),
+			ghost::fixed::type("hello"),
+			ghost::fixed::press(ghost::keyboard::Enter),
+			ghost::fixed::text("ok", 0),
+			ghost::fixed::wheel(1, 5, 5));
+		static_assert(macro.size() == 9, "a fixed script has a step for each it is given");
+		static_assert(macro[0].op_ == ghost::ID::Exec, "a fixed script starts with exec");
+
+		ghost::script s;
+		s.add(ghost::mouse::move(10, 20));
+		s.add(ghost::mouse::down(ghost::mouse::Left, 10, 20));
+		s.add(ghost::mouse::up(ghost::mouse::Left, 12, 22));
+		s.add(ghost::program::wait(0));
+		s.add(ghost::keyboard::type("hello"));
+		s.add(ghost::keyboard::press(ghost::keyboard::Enter));
+		s.add(ghost::keyboard::text("ok", 0));
+		s.add(ghost::mouse::wheel(1, 5, 5));
+		ghost::loopback expected(1 << 10);
+		s.play(expected);
+
+		ghost::loopback played(1 << 10);
+		macro.play(played);
+		same(played, expected, "fixed script");
+
+		ghost::playback burst;
+		burst.burst_ = 64;
+		ghost::loopback batched(1 << 10);
+		macro.play(batched, burst);
+		same(batched, expected, "fixed burst");
+		expect(batched.sends() < played.sends(), "fixed bursts were not batched");
+	}
+
+	// measured replays count every action and time every call, one call for each burst...
+	void stats()
+	{
+		ghost::script s = generate(1000);
+		for (int i = 0; i < 10; ++i)
+			s.add(ghost::program::wait(0));
+		std::uint64_t actions = 1010;
+
+		ghost::loopback quiet(1 << 12);
+		ghost::playStats none = s.play(quiet);
+		expect(!none.enabled(), "stats were measured without being asked for");
+		expectEqual(none.actions(), 0u, "actions counted without being asked for");
+
+		ghost::playback measured;
+		measured.measure_ = true;
+		ghost::loopback played(1 << 12);
+		ghost::playStats stats = s.play(played, measured);
+		expect(stats.enabled(), "stats were not measured");
+		expectEqual(stats.actions(), actions, "actions counted");
+		expectEqual(stats.count(ghost::ID::Wait), 10u, "waits counted");
+		std::uint64_t counted = 0;
+		for (unsigned int id = 0; id <= ghost::ID::CairoElephant; ++id)
+			counted += stats.count(id);
+		expectEqual(counted, actions, "actions counted by op");
+		expectEqual(stats.latency().count(), actions - 10, "calls timed");
+		expectEqual(stats.latency(ghost::ID::Wait).count(), 0u, "waits timed as calls");
+		expectEqual(stats.drift().count(), actions, "actions scheduled");
+		expectEqual(stats.overshoot().count(), 10u, "waits paced");
+
+		ghost::playback burst = measured;
+		burst.burst_ = 64;
+		ghost::loopback batched(1 << 12);
+		ghost::playStats bursts = s.play(batched, burst);
+		expectEqual(bursts.actions(), actions, "actions counted in bursts");
+		expectEqual(bursts.latency().count(), batched.sends(), "bursts timed");
+		expectEqual(bursts.drift().count(), actions, "actions scheduled in bursts");
+		expect(bursts.report().find("latency") != std::string::npos, "the report has no latency");
+	}
+
+	// a traced replay has a span for each action inside one for the replay, each closed...
+	void trace()
+	{
+		ghost::script s = generate(100);
+		s.add(ghost::program::wait(0));
+		ghost::loopback b(1 << 10);
+		ghost::tracer t;
+		t.start();
+		s.play(b);
+		t.stop();
+		expectEqual(t.size(), 102u, "spans traced");
+		expectEqual(t.dropped(), 0u, "spans dropped");
+
+		std::string json = t.json();
+		expect(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0, "the trace does not begin as a chrome trace");
+		std::size_t spans = 0;
+		for (std::size_t at = json.find("\"ph\":\"X\""); at != std::string::npos; at = json.find("\"ph\":\"X\"", at + 1))
+			++spans;
+		expectEqual(spans, 102u, "spans written");
+		expect(json.find("\"name\":\"play\",\"cat\":\"replay\"") != std::string::npos, "the replay has no span");
+		expect(json.find("\"name\":\"wait\",\"cat\":\"wait\"") != std::string::npos, "the wait has no span");
+		expect(json.find("\"dur\":0.000") == std::string::npos, "a span was left open");
+
+		// once stopped nothing more is traced...
+		s.play(b);
+		expectEqual(t.size(), 102u, "spans traced once stopped");
+	}
+
+	// true if f throws an error beginning with what...
+	template<typename F>
+	bool fails(F f, const std::string& what)
+	{
+		try
+		{
+			f();
+		}
+		catch (const std::runtime_error& e)
+		{
+			return std::string(e.what()).compare(0, what.size(), what) == 0;
+		}
+		return false;
+	}
+
+	// waits on windows, named predicates and idle programs hold once the condition does and time out otherwise...
+	void conditions()
+	{
+		ghost::loopback b(1 << 10);
+		ghost::script s("exec {},ww {2000,Save As},wf {2000,Save As},wu {2000,saved},mm {1 2},");
+		bool saved = false;
+		std::mutex m;
+		ghost::program::until::define("saved", [&m, &saved]() { std::lock_guard<std::mutex> lock(m); return saved; });
+		std::thread target([&b, &m, &saved]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			b.show("Save As");
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			std::lock_guard<std::mutex> lock(m);
+			saved = true;
+		});
+		s.play(b);
+		target.join();
+		expectEqual(b.inputs(), 1u, "records sent once the conditions held");
+
+		b.show("Other");
+		expect(fails([&b]() { ghost::script("exec {},wf {50,Save As},").play(b); }, "Timed out"), "focus held on a window without it");
+		expect(fails([&b]() { ghost::script("exec {},ww {50,Missing},").play(b); }, "Timed out"), "a missing window was waited for");
+		ghost::program::until::forget("saved");
+		expect(fails([&b]() { ghost::script("exec {},wu {50,saved},").play(b); }, "Unknown predicate"), "a forgotten predicate was waited on");
+
+#ifndef GHOST_WINDOWS
+		{
+			// nothing to wait for...
+			ghost::program::process::scope nothing((ghost::program::process()));
+			ghost::program::idle::inject(0);
+		}
+
+		// a sleeping program settles, a busy one never does however often it is checked...
+		ghost::program::exec sleeping("sleep 5");
+		sleeping.run();
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		ghost::program::idle::inject(2000);
+		expect(std::chrono::steady_clock::now() - begin >= std::chrono::milliseconds(5000 / sysconf(_SC_CLK_TCK)), "idle before five ticks");
+		kill(sleeping.pid(), SIGKILL);
+		sleeping.wait();
+
+		ghost::program::exec busy("sh -c 'while :; do :; done'");
+		busy.run();
+		bool timedOut = fails([]() { ghost::program::idle::inject(300); }, "Timed out");
+		kill(busy.pid(), SIGKILL);
+		busy.wait();
+		expect(timedOut, "a busy program was idle");
+#endif
+	}
+
+	// entries from many threads drain once each in the order they were logged, those which do not fit are counted,
+	// and a drain may log...
+	void logging()
+	{
+		ghost::logger log(1024);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+			threads.push_back(std::thread([&log, t]()
+			{
+				for (int i = 0; i < 100; ++i)
+				{
+					ghost::binary::record r = ghost::logger::nothing();
+					r.a_ = t;
+					r.b_ = i;
+					log.add(ghost::logger::Info, "step", r, 0);
+				}
+			}));
+		for (std::size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+
+		std::int64_t last = 0;
+		int next[4] = { 0, 0, 0, 0 };
+		bool ordered = true;
+		std::size_t drained = log.drain([&](const ghost::logger::entry& e)
+		{
+			ordered = ordered && e.time_ >= last && e.action_.b_ == next[e.action_.a_]++;
+			last = e.time_;
+		});
+		expectEqual(drained, 400u, "entries drained");
+		expect(ordered, "entries drained out of order");
+		expectEqual(log.drain([](const ghost::logger::entry&) {}), 0u, "entries drained twice");
+		expectEqual(log.dropped(), 0u, "entries dropped");
+
+		// a drain which logs leaves its entries for the next...
+		log.add(ghost::logger::Warning, "first", ghost::logger::nothing(), 0);
+		log.drain([&log](const ghost::logger::entry&) { log.add(ghost::logger::Warning, "again", ghost::logger::nothing(), 0); });
+		std::string what;
+		expectEqual(log.drain([&what](const ghost::logger::entry& e) { what = e.what_; }), 1u, "entries logged while draining");
+		expectEqual(what, std::string("again"), "entry logged while draining");
+
+		// a full ring drops...
+		ghost::logger small(8);
+		for (int i = 0; i < 20; ++i)
+			small.add(ghost::logger::Error, "full", ghost::logger::nothing(), 0);
+		std::size_t kept = small.drain([](const ghost::logger::entry&) {});
+		expect(kept > 0 && kept < 20, "a full ring kept everything");
+		expectEqual(small.dropped(), 20 - kept, "entries dropped from a full ring");
+
+		// filtered by level...
+		ghost::logger::severity previous = ghost::logger::instance().level();
+		ghost::logger::instance().level(ghost::logger::Error);
+		bool debug = ghost::logger::wants<ghost::logger::Debug>(), error = ghost::logger::wants<ghost::logger::Error>();
+		ghost::logger::instance().level(previous);
+		expect(!debug, "debug entries were wanted at error level");
+		expect(error, "error entries were not wanted at error level");
+	}
+
+	// a pacer never wakes early and accounts for every wait, with no budget it only sleeps...
+	void pacer()
+	{
+		typedef std::chrono::steady_clock clock;
+		ghost::pacer sleeping(clock::duration::zero());
+		clock::time_point deadline = clock::now() + std::chrono::milliseconds(3);
+		clock::duration late = sleeping.until(deadline);
+		expect(clock::now() >= deadline, "woke before the deadline");
+		expect(late >= clock::duration::zero(), "late by a negative time");
+		expectEqual(sleeping.waits(), 1u, "waits counted");
+		expect(sleeping.spun() == clock::duration::zero(), "spun without a budget");
+		expect(sleeping.overshoot() == late && sleeping.worst() == late, "overshoot not accounted");
+
+		ghost::pacer spinning(std::chrono::milliseconds(1));
+		for (int i = 0; i < 5; ++i)
+		{
+			deadline = clock::now() + std::chrono::milliseconds(2);
+			spinning.until(deadline);
+			expect(clock::now() >= deadline, "woke before the deadline with a budget");
+		}
+		expectEqual(spinning.waits(), 5u, "waits counted with a budget");
+		expect(spinning.worst() * 5 >= spinning.overshoot(), "worst overshoot less than the mean");
+
+		// a deadline already passed returns at once...
+		spinning.until(clock::now() - std::chrono::milliseconds(1));
+		expectEqual(spinning.waits(), 6u, "a passed deadline was not counted");
+
+		spinning.reset();
+		expectEqual(spinning.waits(), 0u, "waits once reset");
+		expect(spinning.overshoot() == clock::duration::zero() && spinning.worst() == clock::duration::zero() && spinning.spun() == clock::duration::zero(), "measures once reset");
+		spinning.budget(clock::duration::zero());
+		expect(spinning.budget() == clock::duration::zero(), "budget not changed");
+	}
+
+	// an action which takes a while to inject...
+	struct slow : ghost::injectable
+	{
+		void inject() const { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }
+		std::string args() const { return std::string(); }
+		std::string op() const { return "slow"; }
+	};
+
+	// waits are measured from the start of the replay, so time taken by the actions between them is made up rather
+	// than adding to the waits...
+	void timeline()
+	{
+		typedef std::chrono::steady_clock clock;
+		ghost::pacer p;
+		{
+			ghost::timeline t(p);
+			expect(ghost::timeline::current() == &t, "the timeline is not current");
+			t.wait(5);
+			t.wait(5);
+			t.wait(5);
+			expect(t.deadline() - t.start() == std::chrono::milliseconds(15), "deadlines drifted from the start");
+			expect(clock::now() - t.start() >= std::chrono::milliseconds(15), "waits ended early");
+
+			// once behind, syncing carries on from now...
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			t.synced();
+			expect(t.deadline() - t.start() >= std::chrono::milliseconds(20), "synced without moving the deadline");
+		}
+		expect(ghost::timeline::current() == nullptr, "the timeline is still current");
+
+		ghost::script s;
+		for (int i = 0; i < 4; ++i)
+		{
+			s.add(ghost::action(new slow));
+			s.add(ghost::program::wait(30));
+		}
+		ghost::playback options;
+		options.pacer_ = &p;
+		p.reset();
+		ghost::loopback b(1 << 4);
+		clock::time_point begin = clock::now();
+		s.play(b, options);
+		clock::duration elapsed = clock::now() - begin;
+		expectEqual(p.waits(), 4u, "waits paced by the playback's pacer");
+		expect(elapsed >= std::chrono::milliseconds(120), "the replay ended before its waits");
+		expect(elapsed < std::chrono::milliseconds(190), "the actions added to the waits");
+	}
+
+	struct test
+	{
+		const char* name_;
+		void (*run_)();
+	};
+
+	const test tests[] =
+	{
+		{ "syntax/roundtrip", syntaxRoundTrip },
+		{ "syntax/parallel", syntaxParallel },
+		{ "syntax/error", syntaxErrors },
+		{ "binary/roundtrip", binaryRoundTrip },
+		{ "replay", replay },
+		{ "player", player },
+		{ "writer/live", writerLive },
+		{ "record/simplify", simplify },
+		{ "keyboard/text", keyboardText },
+		{ "mouse/screen", mouseScreen },
+		{ "fleet", fleet },
+		{ "session", session },
+		{ "fixed", fixedScript },
+		{ "stats", stats },
+		{ "trace", trace },
+		{ "conditions", conditions },
+		{ "logger", logging },
+		{ "pacer", pacer },
+		{ "timeline", timeline },
+	};
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::cerr << "usage: ghost_tests name" << std::endl;
+		for (const test& t : tests)
+			std::cerr << "\t" << t.name_ << std::endl;
+		return 1;
+	}
+
+	for (const test& t : tests)
+		if (t.name_ == std::string(argv[1]))
+		{
+			try
+			{
+				t.run_();
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << t.name_ << ": " << e.what() << std::endl;
+				return 1;
+			}
+			return 0;
+		}
+
+	std::cerr << "No test named " << argv[1] << std::endl;
+	return 1;
+}